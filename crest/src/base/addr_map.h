@@ -0,0 +1,189 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_ADDR_MAP_H__
+#define BASE_ADDR_MAP_H__
+
+#include <assert.h>
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+
+#include "base/basic_types.h"
+
+using std::vector;
+
+namespace crest {
+
+// A hash map from (non-zero) addresses to pointers, for the symbolic
+// memory of the interpreter.  It uses open addressing with linear
+// probing, and deletes by shifting later entries back, so lookups never
+// have to skip over tombstones.  Address 0 marks an empty slot, and is
+// never in the map.
+//
+// Unlike std::map, iteration is in no particular order; use Sorted() to
+// visit the entries by address.
+template <typename V>
+class AddrMap {
+ public:
+  struct Entry {
+    addr_t first;
+    V second;
+  };
+
+  class const_iterator {
+   public:
+    const_iterator() : p_(NULL), end_(NULL) { }
+    const_iterator(const Entry* p, const Entry* end) : p_(p), end_(end) {
+      Skip();
+    }
+    const Entry& operator*() const { return *p_; }
+    const Entry* operator->() const { return p_; }
+    const_iterator& operator++() { ++p_; Skip(); return *this; }
+    bool operator==(const const_iterator& i) const { return p_ == i.p_; }
+    bool operator!=(const const_iterator& i) const { return p_ != i.p_; }
+   private:
+    const Entry* p_;
+    const Entry* end_;
+    void Skip() { while ((p_ != end_) && (p_->first == 0)) ++p_; }
+  };
+
+  AddrMap() : size_(0), mask_(kInitialCapacity - 1) {
+    slots_.resize(kInitialCapacity);
+    Clear(&slots_);
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const_iterator begin() const {
+    return const_iterator(&slots_.front(), &slots_.front() + slots_.size());
+  }
+  const_iterator end() const {
+    return const_iterator(&slots_.front() + slots_.size(),
+                          &slots_.front() + slots_.size());
+  }
+
+  // Returns the value for 'addr', or NULL if there is none.
+  V Find(addr_t addr) const {
+    if (addr == 0)
+      return NULL;
+    for (size_t i = Hash(addr) & mask_; ; i = (i + 1) & mask_) {
+      const Entry& e = slots_[i];
+      if (e.first == addr)
+        return e.second;
+      if (e.first == 0)
+        return NULL;
+    }
+  }
+
+  // Sets the value for 'addr', and returns the value it replaced (or
+  // NULL).
+  V Set(addr_t addr, V value) {
+    assert(addr != 0);
+    if (2 * (size_ + 1) > slots_.size())
+      Grow();
+    size_t i = Hash(addr) & mask_;
+    while ((slots_[i].first != 0) && (slots_[i].first != addr))
+      i = (i + 1) & mask_;
+    Entry& e = slots_[i];
+    V old = NULL;
+    if (e.first == addr) {
+      old = e.second;
+    } else {
+      e.first = addr;
+      size_++;
+    }
+    e.second = value;
+    return old;
+  }
+
+  // Removes 'addr', and returns its value (or NULL if it was absent).
+  V Erase(addr_t addr) {
+    if (addr == 0)
+      return NULL;
+    size_t i = Hash(addr) & mask_;
+    while (slots_[i].first != addr) {
+      if (slots_[i].first == 0)
+        return NULL;
+      i = (i + 1) & mask_;
+    }
+    V old = slots_[i].second;
+    size_--;
+
+    // Shift back any later entries in the probe run that could no
+    // longer be reached past the hole at i.
+    for (size_t j = (i + 1) & mask_; slots_[j].first != 0; j = (j + 1) & mask_) {
+      size_t home = Hash(slots_[j].first) & mask_;
+      // Move slots_[j] into the hole unless its home lies in (i, j].
+      bool reachable = (i <= j) ? ((i < home) && (home <= j))
+                                : ((i < home) || (home <= j));
+      if (!reachable) {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+    slots_[i].first = 0;
+    slots_[i].second = NULL;
+    return old;
+  }
+
+  // Fills 'entries' with the entries in address order.
+  void Sorted(vector<Entry>* entries) const {
+    entries->clear();
+    entries->reserve(size_);
+    for (const_iterator i = begin(); i != end(); ++i) {
+      entries->push_back(*i);
+    }
+    std::sort(entries->begin(), entries->end(), LessAddr);
+  }
+
+ private:
+  static const size_t kInitialCapacity = 64;
+
+  vector<Entry> slots_;
+  size_t size_;
+  size_t mask_;
+
+  static size_t Hash(addr_t addr) {
+    // Fibonacci hashing.  Addresses are aligned, so their low bits carry
+    // little information; the multiply mixes the high bits down.
+    unsigned long long h = addr * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(h ^ (h >> 32));
+  }
+
+  static bool LessAddr(const Entry& a, const Entry& b) {
+    return a.first < b.first;
+  }
+
+  static void Clear(vector<Entry>* slots) {
+    for (size_t i = 0; i < slots->size(); i++) {
+      (*slots)[i].first = 0;
+      (*slots)[i].second = NULL;
+    }
+  }
+
+  void Grow() {
+    vector<Entry> old;
+    old.swap(slots_);
+    slots_.resize(2 * old.size());
+    Clear(&slots_);
+    mask_ = slots_.size() - 1;
+    size_ = 0;
+    for (size_t i = 0; i < old.size(); i++) {
+      if (old[i].first != 0)
+        Set(old[i].first, old[i].second);
+    }
+  }
+};
+
+}  // namespace crest
+
+#endif  // BASE_ADDR_MAP_H__
@@ -8,6 +8,7 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
 // for details.
 
+#include <stdlib.h>
 #include <limits>
 #include "base/basic_types.h"
 
@@ -71,5 +72,16 @@ const value_t kMaxValue[] = {
   numeric_limits<long long>::max(),
 };
 
+int RankFromEnvironment() {
+  const char* vars[] = { "OMPI_COMM_WORLD_RANK", "PMIX_RANK", "PMI_RANK",
+                         "MV2_COMM_WORLD_RANK" };
+  for (size_t i = 0; i < sizeof(vars) / sizeof(vars[0]); i++) {
+    const char* val = getenv(vars[i]);
+    if (val)
+      return atoi(val);
+  }
+  return 0;
+}
+
 }  // namespace crest
 
@@ -11,6 +11,8 @@
 #ifndef BASE_BASIC_TYPES_H__
 #define BASE_BASIC_TYPES_H__
 
+#include <stddef.h>
+
 namespace crest {
 
 typedef int id_t;
@@ -20,6 +22,21 @@ typedef unsigned int var_t;
 typedef long long int value_t;
 typedef unsigned long int addr_t;
 
+// 64-bit hashes of expressions, predicates, and path prefixes.
+typedef unsigned long long fingerprint_t;
+
+inline fingerprint_t MixFingerprint(fingerprint_t h, unsigned long long v) {
+  h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+  return h * 0xFF51AFD7ED558CCDULL;
+}
+
+// For hash_map's and hash_set's keyed by fingerprint.
+struct FingerprintHash {
+  size_t operator()(fingerprint_t h) const {
+    return static_cast<size_t>(h ^ (h >> 32));
+  }
+};
+
 
 // Virtual "branch ID's" used to represent function calls and returns.
 
@@ -61,6 +78,11 @@ extern const value_t kMaxValue[];
 
 enum mpi_call_t { MPI_INIT, MPI_RECV, MPI_SEND };
 
+// The MPI rank of this process, as advertised by the common MPI
+// launchers (or 0).  Unlike MPI_Comm_rank, usable before MPI_Init and
+// after MPI_Finalize.
+int RankFromEnvironment();
+
 }  // namespace crest
 
 #endif  // BASE_BASIC_TYPES_H__
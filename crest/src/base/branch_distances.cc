@@ -0,0 +1,115 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#include <functional>
+#include <queue>
+#include <utility>
+
+#include "base/branch_distances.h"
+
+using std::greater;
+using std::make_pair;
+using std::pair;
+using std::priority_queue;
+
+namespace crest {
+
+BranchDistances::BranchDistances(const ProgramMetadata* metadata, size_t infinity)
+  : metadata_(metadata), infinity_(infinity), epoch_(0), num_repaired_(0) {
+  Reset();
+}
+
+void BranchDistances::Reset() {
+  dist_.assign(metadata_->max_branch(), 0);
+  target_.assign(metadata_->max_branch(), false);
+  for (size_t i = 0; i < metadata_->num_branches(); i++) {
+    target_[metadata_->branches()[i]] = true;
+  }
+  mark_.assign(metadata_->max_branch(), 0);
+  epoch_ = 0;
+}
+
+bool BranchDistances::HasSupport(branch_id_t b) const {
+  const branch_id_t* j;
+  const branch_id_t* end;
+  for (metadata_->Successors(b, &j, &end); j != end; ++j) {
+    if ((dist_[*j] + 1 == dist_[b]) && !IsAffected(*j))
+      return true;
+  }
+  return false;
+}
+
+void BranchDistances::Cover(branch_id_t b) {
+  if (!target_[b])
+    return;
+  target_[b] = false;
+
+  if (++epoch_ == 0) {
+    // The stamps wrapped around.
+    mark_.assign(mark_.size(), 0);
+    epoch_ = 1;
+  }
+
+  // Find the affected branches.  They are listed in order of (old)
+  // distance, so all the affected branches at distance d are marked
+  // before any branch at distance d+1 is checked for support.
+  affected_.clear();
+  affected_.push_back(b);
+  mark_[b] = epoch_;
+  for (size_t k = 0; k < affected_.size(); k++) {
+    size_t d = dist_[affected_[k]];
+    const branch_id_t* j;
+    const branch_id_t* end;
+    for (metadata_->Predecessors(affected_[k], &j, &end); j != end; ++j) {
+      if ((dist_[*j] == d + 1) && (dist_[*j] < infinity_) && !target_[*j]
+          && !IsAffected(*j) && !HasSupport(*j)) {
+        mark_[*j] = epoch_;
+        affected_.push_back(*j);
+      }
+    }
+  }
+  num_repaired_ += affected_.size();
+
+  // Each affected branch starts from its best unaffected successor ...
+  typedef pair<size_t, branch_id_t> Entry;
+  priority_queue<Entry, vector<Entry>, greater<Entry> > Q;
+  for (size_t k = 0; k < affected_.size(); k++) {
+    branch_id_t i = affected_[k];
+    size_t best = infinity_;
+    const branch_id_t* j;
+    const branch_id_t* end;
+    for (metadata_->Successors(i, &j, &end); j != end; ++j) {
+      if (!IsAffected(*j) && (dist_[*j] + 1 < best))
+        best = dist_[*j] + 1;
+    }
+    dist_[i] = best;
+    if (best < infinity_)
+      Q.push(make_pair(best, i));
+  }
+
+  // ... and then from each other, in order of distance.
+  while (!Q.empty()) {
+    Entry e = Q.top();
+    Q.pop();
+    if (e.first != dist_[e.second])
+      continue;
+    const branch_id_t* j;
+    const branch_id_t* end;
+    for (metadata_->Predecessors(e.second, &j, &end); j != end; ++j) {
+      if (IsAffected(*j) && (e.first + 1 < dist_[*j])) {
+        dist_[*j] = e.first + 1;
+        Q.push(make_pair(e.first + 1, *j));
+      }
+    }
+  }
+}
+
+}  // namespace crest
@@ -0,0 +1,76 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#ifndef BASE_BRANCH_DISTANCES_H__
+#define BASE_BRANCH_DISTANCES_H__
+
+#include <stddef.h>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/program_metadata.h"
+
+using std::vector;
+
+namespace crest {
+
+// The distance, in the thinned CFG, from each branch to the nearest
+// uncovered branch (the targets), kept up to date as branches get
+// covered.
+//
+// Covering a branch only removes a target, so distances only grow.
+// Cover() first finds the branches whose every shortest path ran
+// through the removed target -- walking the reverse CFG from it one
+// distance level at a time -- and then recomputes just those, with a
+// Dijkstra-style pass seeded from their unaffected successors.  Every
+// other distance is left untouched.
+class BranchDistances {
+ public:
+  // Distances of 'infinity' or more are reported as 'infinity'.
+  BranchDistances(const ProgramMetadata* metadata, size_t infinity);
+
+  // Makes every branch a target again (all distances 0).
+  void Reset();
+
+  // Removes target 'b' (if it is one), updating the distances.
+  void Cover(branch_id_t b);
+
+  size_t operator[](branch_id_t b) const { return dist_[b]; }
+  bool is_target(branch_id_t b) const { return target_[b]; }
+
+  // The number of branches whose distance was recomputed, over all
+  // calls to Cover().
+  size_t num_repaired() const { return num_repaired_; }
+
+ private:
+  const ProgramMetadata* metadata_;
+  const size_t infinity_;
+
+  vector<size_t> dist_;
+  vector<bool> target_;
+
+  // Marks the branches affected by the current Cover() (epoch_ stamps,
+  // so they need no clearing), and lists them.
+  vector<unsigned> mark_;
+  unsigned epoch_;
+  vector<branch_id_t> affected_;
+
+  size_t num_repaired_;
+
+  bool IsAffected(branch_id_t b) const { return mark_[b] == epoch_; }
+  // Whether 'b' keeps a successor at distance dist_[b] - 1 that is not
+  // affected.
+  bool HasSupport(branch_id_t b) const;
+};
+
+}  // namespace crest
+
+#endif  // BASE_BRANCH_DISTANCES_H__
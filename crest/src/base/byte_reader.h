@@ -0,0 +1,79 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_BYTE_READER_H__
+#define BASE_BYTE_READER_H__
+
+#include <stddef.h>
+#include <string.h>
+
+namespace crest {
+
+// Reads fields in place from a block of memory (a serialized execution,
+// typically mapped from its file).  Reading past the end, or a malformed
+// varint, puts the reader into a failed state in which every read fails.
+class ByteReader {
+ public:
+  ByteReader(const char* data, size_t len)
+    : p_(data), end_(data + len), failed_(false) { }
+
+  bool failed() const { return failed_; }
+  size_t remaining() const { return end_ - p_; }
+
+  // Returns 'len' bytes in place and skips past them, or NULL.
+  const char* View(size_t len) {
+    if (failed_ || (len > remaining())) {
+      failed_ = true;
+      return NULL;
+    }
+    const char* p = p_;
+    p_ += len;
+    return p;
+  }
+
+  bool Read(void* dst, size_t len) {
+    const char* p = View(len);
+    if (p)
+      memcpy(dst, p, len);
+    return (p != NULL);
+  }
+
+  // Returns the next byte, or -1.
+  int Get() {
+    const char* p = View(1);
+    return p ? static_cast<unsigned char>(*p) : -1;
+  }
+
+  // See base/varint.h.
+  bool ReadVarint(unsigned long long* v) {
+    unsigned long long x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      int c = Get();
+      if (c < 0)
+        return false;
+      x |= static_cast<unsigned long long>(c & 0x7F) << shift;
+      if (!(c & 0x80)) {
+        *v = x;
+        return true;
+      }
+    }
+    failed_ = true;
+    return false;
+  }
+
+ private:
+  const char* p_;
+  const char* end_;
+  bool failed_;
+};
+
+}  // namespace crest
+
+#endif  // BASE_BYTE_READER_H__
@@ -0,0 +1,107 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base/coverage_map.h"
+
+namespace crest {
+
+typedef unsigned long long word_t;
+
+const char* CoverageMap::kEnvVar = "CREST_COVERAGE";
+
+CoverageMap::CoverageMap(const string& name, unsigned char* bytes, size_t size, bool owner)
+  : name_(name), bytes_(bytes), size_(size), owner_(owner) { }
+
+CoverageMap* CoverageMap::Create(size_t num_branches, const string& tag) {
+  char buff[64];
+  snprintf(buff, sizeof(buff), "/crest_cov.%d.%s", (int)getpid(), tag.c_str());
+  string name = buff;
+
+  size_t size = (num_branches + sizeof(word_t) - 1) / sizeof(word_t) * sizeof(word_t);
+  if (size == 0)
+    size = sizeof(word_t);
+
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if ((fd < 0) || ftruncate(fd, size)) {
+    perror("Warning: no shared coverage map");
+    if (fd >= 0) {
+      close(fd);
+      shm_unlink(name.c_str());
+    }
+    return NULL;
+  }
+  void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    perror("Warning: no shared coverage map");
+    shm_unlink(name.c_str());
+    return NULL;
+  }
+  return new CoverageMap(name, static_cast<unsigned char*>(p), size, true);
+}
+
+CoverageMap* CoverageMap::FromEnvironment() {
+  const char* name = getenv(kEnvVar);
+  if (!name)
+    return NULL;
+
+  int fd = shm_open(name, O_RDWR, 0);
+  struct stat st;
+  if ((fd < 0) || fstat(fd, &st)) {
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  void* p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return NULL;
+  return new CoverageMap(name, static_cast<unsigned char*>(p), st.st_size, false);
+}
+
+CoverageMap::~CoverageMap() {
+  munmap(bytes_, size_);
+  if (owner_)
+    shm_unlink(name_.c_str());
+}
+
+void CoverageMap::Export() const {
+  setenv(kEnvVar, name_.c_str(), 1);
+}
+
+void CoverageMap::Clear() {
+  memset(bytes_, 0, size_);
+}
+
+void CoverageMap::Collect(vector<branch_id_t>* bids) const {
+  const word_t* words = reinterpret_cast<const word_t*>(bytes_);
+  const size_t num_words = size_ / sizeof(word_t);
+  for (size_t i = 0; i < num_words; i++) {
+    // Most words are zero; only look at the bytes of the others.
+    if (words[i] == 0)
+      continue;
+    const size_t first = i * sizeof(word_t);
+    for (size_t j = first; j < first + sizeof(word_t); j++) {
+      if (bytes_[j])
+        bids->push_back(static_cast<branch_id_t>(j));
+    }
+  }
+}
+
+}  // namespace crest
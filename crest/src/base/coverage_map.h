@@ -0,0 +1,73 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_COVERAGE_MAP_H__
+#define BASE_COVERAGE_MAP_H__
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// The branches covered by a run of the program under test, in a shared
+// memory segment that every rank writes to directly.  run_crest creates
+// the map, clears it before each run, and collects it afterwards.
+//
+// There is one byte per branch, rather than one bit, so that ranks can
+// mark branches with plain stores instead of atomic read-modify-writes.
+class CoverageMap {
+ public:
+  // The environment variable naming the map for the program under test.
+  static const char* kEnvVar;
+
+  // Creates a map for branch ids [0, num_branches), named by 'tag' (and
+  // our pid).  Returns NULL, with a warning, if shared memory is not
+  // available.
+  static CoverageMap* Create(size_t num_branches, const string& tag);
+
+  // Attaches to the map named in the environment, or returns NULL if
+  // there is none.
+  static CoverageMap* FromEnvironment();
+
+  ~CoverageMap();
+
+  // Names this map in the environment, for programs started after.
+  void Export() const;
+
+  void Cover(branch_id_t bid) {
+    if (static_cast<size_t>(bid) < size_)
+      bytes_[bid] = 1;
+  }
+
+  void Clear();
+
+  // Appends the covered branch ids to 'bids', in order.  Takes time in
+  // proportion to the number of words in the map (plus the number of
+  // covered branches).
+  void Collect(vector<branch_id_t>* bids) const;
+
+ private:
+  CoverageMap(const string& name, unsigned char* bytes, size_t size, bool owner);
+
+  const string name_;
+  unsigned char* bytes_;
+  size_t size_;  // A multiple of the word size.
+  const bool owner_;
+};
+
+}  // namespace crest
+
+#endif  // BASE_COVERAGE_MAP_H__
@@ -0,0 +1,95 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#include <algorithm>
+
+#include "base/dependency_index.h"
+
+namespace crest {
+
+const var_t DependencyIndex::kNoVar;
+
+void DependencyIndex::Clear() {
+  nodes_.clear();
+  first_var_.clear();
+}
+
+DependencyIndex::Node& DependencyIndex::GetNode(var_t v) {
+  if (static_cast<size_t>(v) >= nodes_.size()) {
+    size_t old_size = nodes_.size();
+    nodes_.resize(v + 1);
+    for (size_t i = old_size; i < nodes_.size(); i++) {
+      nodes_[i].parent = i;
+    }
+  }
+  return nodes_[v];
+}
+
+var_t DependencyIndex::Find(var_t v, size_t t) const {
+  while ((nodes_[v].parent != v) && (nodes_[v].link_time <= t))
+    v = nodes_[v].parent;
+  return v;
+}
+
+void DependencyIndex::Add(const vector<var_t>& vars) {
+  const size_t t = first_var_.size();
+  if (vars.empty()) {
+    first_var_.push_back(kNoVar);
+    return;
+  }
+
+  var_t first = vars[0];
+  GetNode(first).constraints.push_back(t);
+  first_var_.push_back(first);
+
+  for (size_t i = 1; i < vars.size(); i++) {
+    GetNode(vars[i]);
+    var_t a = Find(first, t);
+    var_t b = Find(vars[i], t);
+    if (a == b)
+      continue;
+    if (nodes_[a].rank < nodes_[b].rank)
+      std::swap(a, b);
+    if (nodes_[a].rank == nodes_[b].rank)
+      nodes_[a].rank++;
+    nodes_[b].parent = a;
+    nodes_[b].link_time = t;
+    nodes_[a].children.push_back(b);
+  }
+}
+
+void DependencyIndex::Slice(size_t i, vector<size_t>* slice, vector<var_t>* vars) const {
+  slice->clear();
+  vars->clear();
+  if (first_var_[i] == kNoVar)
+    return;
+
+  // Walk the tree of the component as it was after constraint i.  The
+  // children and constraints of each node are in time order, so each
+  // walk stops at the first one past i.
+  vector<var_t> stack(1, Find(first_var_[i], i));
+  while (!stack.empty()) {
+    const Node& n = nodes_[stack.back()];
+    vars->push_back(stack.back());
+    stack.pop_back();
+    for (size_t j = 0; (j < n.constraints.size()) && (n.constraints[j] <= i); j++) {
+      slice->push_back(n.constraints[j]);
+    }
+    for (size_t j = 0; j < n.children.size(); j++) {
+      if (nodes_[n.children[j]].link_time > i)
+        break;
+      stack.push_back(n.children[j]);
+    }
+  }
+  std::sort(slice->begin(), slice->end());
+}
+
+}  // namespace crest
@@ -0,0 +1,75 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#ifndef BASE_DEPENDENCY_INDEX_H__
+#define BASE_DEPENDENCY_INDEX_H__
+
+#include <stddef.h>
+#include <vector>
+
+#include "base/basic_types.h"
+
+using std::vector;
+
+namespace crest {
+
+// Tracks which constraints of a path depend on each other (through
+// shared variables), for solving only the slice of a path prefix that a
+// negated constraint depends on.
+//
+// Constraints are added in path order.  A union-find over the variables
+// joins the variables of each constraint; it uses union by rank and no
+// path compression, and stamps each link with the constraint that made
+// it.  Following only the links made by constraints [0..i] gives the
+// components as they were after constraint i, so one index answers the
+// queries for every prefix.
+class DependencyIndex {
+ public:
+  DependencyIndex() { }
+
+  void Clear();
+
+  // The number of constraints added.
+  size_t size() const { return first_var_.size(); }
+
+  // Adds constraint number size(), with variables 'vars'.
+  void Add(const vector<var_t>& vars);
+
+  // Fills 'slice' with the indices, in order, of the constraints among
+  // [0..i] that constraint i depends on (including i), and 'vars' with
+  // their variables.  Takes time in proportion to the slice.
+  void Slice(size_t i, vector<size_t>* slice, vector<var_t>* vars) const;
+
+ private:
+  struct Node {
+    Node() : parent(kNoVar), link_time(0), rank(0) { }
+
+    var_t parent;                 // Itself, for a root.
+    size_t link_time;             // The constraint that linked it.
+    unsigned rank;
+    vector<var_t> children;       // In the order linked.
+    vector<size_t> constraints;   // Those whose first variable this is.
+  };
+
+  static const var_t kNoVar = static_cast<var_t>(-1);
+
+  vector<Node> nodes_;
+  // The first variable of each constraint (kNoVar if it has none).
+  vector<var_t> first_var_;
+
+  // The root of 'v' after constraint 't'.
+  var_t Find(var_t v, size_t t) const;
+  Node& GetNode(var_t v);
+};
+
+}  // namespace crest
+
+#endif  // BASE_DEPENDENCY_INDEX_H__
@@ -0,0 +1,83 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "base/fork_server.h"
+
+namespace crest {
+namespace fork_server {
+
+const char kEnvVar[] = "CREST_FORK_SERVER";
+
+string CommandFifo(int rank) {
+  char buff[64];
+  snprintf(buff, sizeof(buff), "fork_server_cmd.%d", rank);
+  return string(buff);
+}
+
+string ReplyFifo(int rank) {
+  char buff[64];
+  snprintf(buff, sizeof(buff), "fork_server_reply.%d", rank);
+  return string(buff);
+}
+
+bool ReadAll(int fd, void* buf, size_t len) {
+  char* p = static_cast<char*>(buf);
+  while (len > 0) {
+    ssize_t n = read(fd, p, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const void* buf, size_t len) {
+  const char* p = static_cast<const char*>(buf);
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool WriteRunCommand(int fd, const vector<value_t>& input) {
+  char cmd = RUN;
+  size_t len = input.size();
+  return (WriteAll(fd, &cmd, sizeof(cmd))
+          && WriteAll(fd, &len, sizeof(len))
+          && ((len == 0) || WriteAll(fd, &input.front(), len * sizeof(value_t))));
+}
+
+bool ReadCommand(int fd, vector<value_t>* input) {
+  char cmd;
+  if (!ReadAll(fd, &cmd, sizeof(cmd)) || (cmd != RUN))
+    return false;
+
+  size_t len;
+  if (!ReadAll(fd, &len, sizeof(len)))
+    return false;
+  input->resize(len);
+  return ((len == 0) || ReadAll(fd, &input->front(), len * sizeof(value_t)));
+}
+
+}  // namespace fork_server
+}  // namespace crest
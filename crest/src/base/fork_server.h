@@ -0,0 +1,63 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_FORK_SERVER_H__
+#define BASE_FORK_SERVER_H__
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// Protocol between run_crest and an instrumented MPI program running as
+// a fork server.
+//
+// run_crest starts the MPI job once, with kEnvVar set.  After MPI_Init,
+// every rank opens its own FIFOs CommandFifo(rank) and ReplyFifo(rank),
+// writes its rank to the latter to report ready, and parks in a loop
+// reading commands from the former.  For each test, run_crest writes a RUN command
+// (followed by the input vector) to every rank, and each rank forks a
+// child that runs the rest of the program on that input.  When its child
+// exits, a rank writes the child's exit status to ReplyFifo(rank).  A
+// QUIT command (or end-of-file) shuts the job down.
+//
+// The parked parents never touch MPI again, so every child starts from
+// the same MPI state, the one right after MPI_Init.
+namespace fork_server {
+
+extern const char kEnvVar[];
+
+string CommandFifo(int rank);
+string ReplyFifo(int rank);
+
+enum command_t { RUN = 'R', QUIT = 'Q' };
+
+// Read/write exactly 'len' bytes, retrying on short reads/writes.
+// Return false on error or end-of-file.
+bool ReadAll(int fd, void* buf, size_t len);
+bool WriteAll(int fd, const void* buf, size_t len);
+
+// Writes a RUN command for the given input.
+bool WriteRunCommand(int fd, const vector<value_t>& input);
+
+// Reads the next command.  Returns false on QUIT or end-of-file.
+bool ReadCommand(int fd, vector<value_t>* input);
+
+}  // namespace fork_server
+
+}  // namespace crest
+
+#endif  // BASE_FORK_SERVER_H__
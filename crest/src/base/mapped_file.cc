@@ -0,0 +1,60 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base/mapped_file.h"
+
+namespace crest {
+
+MappedFile::MappedFile() : data_(NULL), size_(0) { }
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const string& path) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return false;
+  }
+
+  // (mmap rejects an empty mapping, but an empty file is fine.)
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void* p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      size_ = 0;
+      return false;
+    }
+    data_ = static_cast<const char*>(p);
+  }
+  close(fd);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_)
+    munmap(const_cast<char*>(data_), size_);
+  data_ = NULL;
+  size_ = 0;
+}
+
+}  // namespace crest
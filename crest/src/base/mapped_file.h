@@ -0,0 +1,45 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_MAPPED_FILE_H__
+#define BASE_MAPPED_FILE_H__
+
+#include <stddef.h>
+#include <string>
+
+using std::string;
+
+namespace crest {
+
+// A whole file mapped read-only into memory, for parsing in place.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  // Returns false (with errno set) if 'path' cannot be opened or mapped.
+  bool Open(const string& path);
+  void Close();
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+
+  // Not copyable.
+  MappedFile(const MappedFile&);
+  void operator=(const MappedFile&);
+};
+
+}  // namespace crest
+
+#endif  // BASE_MAPPED_FILE_H__
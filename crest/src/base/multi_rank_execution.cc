@@ -0,0 +1,50 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <assert.h>
+
+#include "base/multi_rank_execution.h"
+
+namespace crest {
+
+void MultiRankExecution::Clear() {
+  SymbolicExecution empty;
+  ex_.Swap(empty);
+  ranks_.clear();
+  branch_begin_.clear();
+  constraint_begin_.clear();
+}
+
+void MultiRankExecution::AddRank(int rank, SymbolicExecution* ex) {
+  assert(ranks_.empty() || (rank > ranks_.back()));
+  ranks_.push_back(rank);
+  branch_begin_.push_back(ex_.path().branches().size());
+  constraint_begin_.push_back(ex_.path().num_constraints());
+
+  // The ranks agree on the inputs they have in common.  A rank that read
+  // more inputs than the others contributes the extra ones.
+  map<var_t,type_t>* vars = ex_.mutable_vars();
+  vars->insert(ex->vars().begin(), ex->vars().end());
+  vector<value_t>* inputs = ex_.mutable_inputs();
+  if (ex->inputs().size() > inputs->size()) {
+    inputs->insert(inputs->end(), ex->inputs().begin() + inputs->size(), ex->inputs().end());
+  }
+
+  ex_.mutable_path()->Append(ex->mutable_path());
+
+  vector<RecvEvent>* receives = ex_.mutable_receives();
+  size_t first = receives->size();
+  receives->insert(receives->end(), ex->receives().begin(), ex->receives().end());
+  for (size_t i = first; i < receives->size(); i++) {
+    (*receives)[i].rank = rank;
+  }
+}
+
+}  // namespace crest
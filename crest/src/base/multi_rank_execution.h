@@ -0,0 +1,58 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_MULTI_RANK_EXECUTION_H__
+#define BASE_MULTI_RANK_EXECUTION_H__
+
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_execution.h"
+
+using std::vector;
+
+namespace crest {
+
+// The executions of all MPI ranks in one run of the program under test,
+// merged into a single SymbolicExecution.
+//
+// Every rank reads its inputs from the same input vector, so input
+// variable i means the same input in all ranks and the input space is
+// shared.  The paths of the ranks are concatenated in rank order; the
+// path of each rank is the slice of the merged path starting at its
+// branch_begin() (and its constraints start at constraint_begin()).
+class MultiRankExecution {
+ public:
+  MultiRankExecution() { }
+
+  void Clear();
+
+  // Adds the execution of 'rank', which must come after all ranks added
+  // so far.  Takes the path constraints of 'ex'.
+  void AddRank(int rank, SymbolicExecution* ex);
+
+  size_t num_ranks() const { return ranks_.size(); }
+  int rank(size_t i) const { return ranks_[i]; }
+  size_t branch_begin(size_t i) const { return branch_begin_[i]; }
+  size_t constraint_begin(size_t i) const { return constraint_begin_[i]; }
+
+  const SymbolicExecution& execution() const { return ex_; }
+  SymbolicExecution* mutable_execution() { return &ex_; }
+
+ private:
+  SymbolicExecution ex_;
+  vector<int> ranks_;
+  vector<size_t> branch_begin_;
+  vector<size_t> constraint_begin_;
+};
+
+}  // namespace crest
+
+#endif  // BASE_MULTI_RANK_EXECUTION_H__
@@ -0,0 +1,47 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <new>
+
+#include "base/object_pool.h"
+
+namespace crest {
+
+namespace {
+
+// Objects are kept 16-byte aligned, like malloc'd memory.
+size_t RoundUp(size_t n) {
+  if (n < sizeof(void*))
+    n = sizeof(void*);
+  return (n + 15) & ~static_cast<size_t>(15);
+}
+
+}  // namespace
+
+ObjectPool::ObjectPool(size_t object_size, size_t objects_per_slab)
+  : object_size_(RoundUp(object_size)), objects_per_slab_(objects_per_slab),
+    free_(NULL) { }
+
+ObjectPool::~ObjectPool() {
+  for (size_t i = 0; i < slabs_.size(); i++) {
+    ::operator delete(slabs_[i]);
+  }
+}
+
+void ObjectPool::Grow() {
+  char* slab = static_cast<char*>(::operator new(object_size_ * objects_per_slab_));
+  slabs_.push_back(slab);
+  // Thread the new objects onto the free list, lowest address first.
+  for (size_t i = objects_per_slab_; i > 0; i--) {
+    Free(slab + (i - 1) * object_size_);
+  }
+}
+
+}  // namespace crest
@@ -0,0 +1,65 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_OBJECT_POOL_H__
+#define BASE_OBJECT_POOL_H__
+
+#include <stddef.h>
+#include <vector>
+
+using std::vector;
+
+namespace crest {
+
+// An allocator for objects of one fixed size.  Memory is carved out of
+// large slabs, and freed objects go on a free list for reuse, so neither
+// allocating nor freeing an object calls malloc.  The slabs are only
+// returned (all at once) when the pool is destroyed.
+class ObjectPool {
+ public:
+  ObjectPool(size_t object_size, size_t objects_per_slab);
+  ~ObjectPool();
+
+  void* Allocate() {
+    if (free_ == NULL)
+      Grow();
+    FreeBlock* b = free_;
+    free_ = b->next;
+    return b;
+  }
+
+  void Free(void* p) {
+    FreeBlock* b = static_cast<FreeBlock*>(p);
+    b->next = free_;
+    free_ = b;
+  }
+
+  size_t object_size() const { return object_size_; }
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  const size_t object_size_;
+  const size_t objects_per_slab_;
+  FreeBlock* free_;
+  vector<char*> slabs_;
+
+  void Grow();
+
+  // Not copyable.
+  ObjectPool(const ObjectPool&);
+  void operator=(const ObjectPool&);
+};
+
+}  // namespace crest
+
+#endif  // BASE_OBJECT_POOL_H__
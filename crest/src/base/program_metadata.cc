@@ -0,0 +1,243 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#include <algorithm>
+#include <fstream>
+#include <string.h>
+
+#include "base/byte_reader.h"
+#include "base/program_metadata.h"
+
+using std::ifstream;
+using std::max;
+
+namespace crest {
+
+const char ProgramMetadata::kFile[] = "crest_metadata";
+
+static const char kMagic[8] = "CRESTMD";
+
+ProgramMetadata::ProgramMetadata() : header_(NULL) { }
+
+bool ProgramMetadata::Open(const string& file) {
+  if (!file_.Open(file))
+    return false;
+  if (!View(file_.data(), file_.size())) {
+    file_.Close();
+    return false;
+  }
+  return true;
+}
+
+// Appends 'v' to 's', padded to a multiple of 8 bytes.
+template <typename T>
+static void AppendArray(const vector<T>& v, string* s) {
+  if (!v.empty())
+    s->append(reinterpret_cast<const char*>(&v.front()), v.size() * sizeof(T));
+  s->resize((s->size() + 7) & ~static_cast<size_t>(7), '\0');
+}
+
+// Points 'p' at the next array of 'n' elements in [*pos, end).
+template <typename T>
+static bool NextArray(const char** pos, const char* end, size_t n, const T** p) {
+  size_t len = (n * sizeof(T) + 7) & ~static_cast<size_t>(7);
+  if ((n > static_cast<size_t>(end - *pos) / sizeof(T)) || (len > static_cast<size_t>(end - *pos)))
+    return false;
+  *p = reinterpret_cast<const T*>(*pos);
+  *pos += len;
+  return true;
+}
+
+// Are 'offsets' (n + 1 of them) non-decreasing from 0 to 'num_edges', and
+// the 'targets' all in [0, n)?
+static bool ValidCsr(const size_t* offsets, const branch_id_t* targets, size_t n, size_t num_edges) {
+  if (offsets[0] != 0 || offsets[n] != num_edges)
+    return false;
+  for (size_t i = 0; i < n; i++) {
+    if (offsets[i] > offsets[i + 1])
+      return false;
+  }
+  for (size_t i = 0; i < num_edges; i++) {
+    if ((targets[i] < 0) || (static_cast<size_t>(targets[i]) >= n))
+      return false;
+  }
+  return true;
+}
+
+bool ProgramMetadata::View(const char* data, size_t len) {
+  header_ = NULL;
+  const char* pos = data;
+  const char* end = data + len;
+  const Header* h;
+  if (!NextArray(&pos, end, 1, &h) || memcmp(h->magic, kMagic, sizeof(kMagic))
+      || (h->version != kVersion) || (h->max_branch < 1))
+    return false;
+
+  size_t n = h->max_branch;
+  if (!NextArray(&pos, end, h->num_functions, &branch_count_)
+      || !NextArray(&pos, end, h->num_branches, &branches_)
+      || !NextArray(&pos, end, n, &paired_)
+      || !NextArray(&pos, end, n, &function_)
+      || !NextArray(&pos, end, n + 1, &cfg_offsets_)
+      || !NextArray(&pos, end, h->num_edges, &cfg_targets_)
+      || !NextArray(&pos, end, n + 1, &rev_offsets_)
+      || !NextArray(&pos, end, h->num_edges, &rev_targets_))
+    return false;
+
+  for (size_t i = 0; i < h->num_branches; i++) {
+    if ((branches_[i] < 0) || (static_cast<size_t>(branches_[i]) >= n))
+      return false;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if ((paired_[i] < 0) || (static_cast<size_t>(paired_[i]) >= n) || (function_[i] >= h->num_functions))
+      return false;
+  }
+  if (!ValidCsr(cfg_offsets_, cfg_targets_, n, h->num_edges)
+      || !ValidCsr(rev_offsets_, rev_targets_, n, h->num_edges))
+    return false;
+
+  header_ = h;
+  return true;
+}
+
+void ProgramMetadata::Serialize(const vector< vector<branch_id_t> >& functions,
+                                const vector< pair<branch_id_t, vector<branch_id_t> > >& cfg,
+                                string* s) {
+  // The branches, and their pairs and functions.  (Function j is line j
+  // of "branches", counting from 1.)
+  branch_id_t max_branch = 0;
+  vector<branch_id_t> branches;
+  for (size_t j = 0; j < functions.size(); j++) {
+    for (size_t k = 0; k < functions[j].size(); k++) {
+      max_branch = max(max_branch, functions[j][k]);
+      branches.push_back(functions[j][k]);
+    }
+  }
+  max_branch++;
+  sort(branches.begin(), branches.end());
+
+  vector<function_id_t> branch_count(functions.size() + 1, 0);
+  vector<branch_id_t> paired(max_branch, 0);
+  vector<function_id_t> function(max_branch, 0);
+  for (size_t j = 0; j < functions.size(); j++) {
+    const vector<branch_id_t>& bs = functions[j];
+    branch_count[j + 1] = bs.size();
+    for (size_t k = 0; k + 1 < bs.size(); k += 2) {
+      paired[bs[k]] = bs[k + 1];
+      paired[bs[k + 1]] = bs[k];
+    }
+    for (size_t k = 0; k < bs.size(); k++) {
+      function[bs[k]] = j + 1;
+    }
+  }
+
+  // The CFG and its reverse, in compressed sparse row form.  Edges
+  // between non-branches are dropped.  The predecessors of each branch
+  // are in increasing order.
+  vector< vector<branch_id_t> > succs(max_branch);
+  for (size_t i = 0; i < cfg.size(); i++) {
+    branch_id_t src = cfg[i].first;
+    if ((src < 0) || (src >= max_branch))
+      continue;
+    succs[src].clear();
+    for (size_t j = 0; j < cfg[i].second.size(); j++) {
+      branch_id_t dst = cfg[i].second[j];
+      if ((dst >= 0) && (dst < max_branch))
+        succs[src].push_back(dst);
+    }
+  }
+  vector<size_t> cfg_offsets(max_branch + 1, 0), rev_offsets(max_branch + 1, 0);
+  for (branch_id_t b = 0; b < max_branch; b++) {
+    cfg_offsets[b + 1] = cfg_offsets[b] + succs[b].size();
+    for (size_t j = 0; j < succs[b].size(); j++) {
+      rev_offsets[succs[b][j] + 1]++;
+    }
+  }
+  for (branch_id_t b = 0; b < max_branch; b++) {
+    rev_offsets[b + 1] += rev_offsets[b];
+  }
+  size_t num_edges = cfg_offsets[max_branch];
+  vector<branch_id_t> cfg_targets, rev_targets(num_edges);
+  cfg_targets.reserve(num_edges);
+  vector<size_t> fill(rev_offsets.begin(), rev_offsets.end() - 1);
+  for (branch_id_t b = 0; b < max_branch; b++) {
+    cfg_targets.insert(cfg_targets.end(), succs[b].begin(), succs[b].end());
+    for (size_t j = 0; j < succs[b].size(); j++) {
+      rev_targets[fill[succs[b][j]]++] = b;
+    }
+  }
+
+  Header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kVersion;
+  h.num_functions = branch_count.size();
+  h.num_branches = branches.size();
+  h.max_branch = max_branch;
+  h.num_edges = num_edges;
+
+  s->clear();
+  AppendArray(vector<Header>(1, h), s);
+  AppendArray(branch_count, s);
+  AppendArray(branches, s);
+  AppendArray(paired, s);
+  AppendArray(function, s);
+  AppendArray(cfg_offsets, s);
+  AppendArray(cfg_targets, s);
+  AppendArray(rev_offsets, s);
+  AppendArray(rev_targets, s);
+}
+
+bool ProgramMetadata::ReadTextFiles(const string& branches_file, const string& cfg_file) {
+  vector< vector<branch_id_t> > functions;
+  {
+    ifstream in(branches_file.c_str());
+    if (!in)
+      return false;
+    function_id_t fid;
+    int num_branches;
+    while (in >> fid >> num_branches) {
+      functions.push_back(vector<branch_id_t>(2 * num_branches));
+      vector<branch_id_t>& bs = functions.back();
+      for (size_t i = 0; i < bs.size(); i++) {
+        if (!(in >> bs[i]))
+          return false;
+      }
+    }
+  }
+
+  // "cfg_branches": the number of branches, then each branch with the
+  // number of its successors and the successors.
+  vector< pair<branch_id_t, vector<branch_id_t> > > cfg;
+  MappedFile cfg_in;
+  if (cfg_in.Open(cfg_file)) {
+    ByteReader r(cfg_in.data(), cfg_in.size());
+    size_t num_branches, len;
+    if (!r.Read(&num_branches, sizeof(num_branches)) || (num_branches > r.remaining()))
+      return false;
+    cfg.resize(num_branches);
+    for (size_t i = 0; i < num_branches; i++) {
+      if (!r.Read(&cfg[i].first, sizeof(branch_id_t)) || !r.Read(&len, sizeof(len))
+          || (len > r.remaining() / sizeof(branch_id_t)))
+        return false;
+      cfg[i].second.resize(len);
+      if (len > 0)
+        r.Read(&cfg[i].second.front(), len * sizeof(branch_id_t));
+    }
+    if (r.failed())
+      return false;
+  }
+
+  Serialize(functions, cfg, &built_);
+  return View(built_.data(), built_.size());
+}
+
+}  // namespace crest
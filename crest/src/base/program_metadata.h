@@ -0,0 +1,128 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#ifndef BASE_PROGRAM_METADATA_H__
+#define BASE_PROGRAM_METADATA_H__
+
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/mapped_file.h"
+
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// What run_crest knows about the instrumented program: its branches,
+// grouped by function, and the control-flow graph thinned down to edges
+// between branches (see process_cfg).
+//
+// process_cfg writes it to kFile as one binary bundle, laid out as
+// run_crest uses it, so run_crest just maps the file:
+//
+//   header        magic "CRESTMD", version, and the counts below
+//   branch_count  [num_functions]  branches per function (function 0,
+//                                  like the functions with no branches,
+//                                  has none)
+//   branches      [num_branches]   all branch ids, sorted
+//   paired        [max_branch]     the other branch of each branch
+//   function      [max_branch]     the function of each branch
+//   cfg           [max_branch + 1] offsets, then [num_edges] targets
+//   reverse cfg   [max_branch + 1] offsets, then [num_edges] targets
+//
+// Each array starts on an 8-byte boundary.  Ids that are not branches
+// have pair and function 0 and no edges.
+class ProgramMetadata {
+ public:
+  static const char kFile[];
+
+  ProgramMetadata();
+
+  // Maps 'file'.  Returns false if it is missing, malformed, or of
+  // another version.
+  bool Open(const string& file);
+
+  // Builds the bundle from the text files written by the instrumentation
+  // ("branches", one line per function with its branch pairs) and by
+  // process_cfg ("cfg_branches"), for programs instrumented before the
+  // bundle existed.  A missing CFG file leaves the CFG empty.
+  bool ReadTextFiles(const string& branches_file, const string& cfg_file);
+
+  // Writes the bundle for 'functions' (the branch ids of each function
+  // in "branches", in pairs) and the thinned CFG 'cfg' (each branch with
+  // its successors) into 's'.
+  static void Serialize(const vector< vector<branch_id_t> >& functions,
+                        const vector< pair<branch_id_t, vector<branch_id_t> > >& cfg,
+                        string* s);
+
+  size_t num_functions() const { return header_->num_functions; }
+  size_t num_branches() const { return header_->num_branches; }
+  // One more than the largest branch id.
+  branch_id_t max_branch() const { return header_->max_branch; }
+
+  const function_id_t* branch_count() const { return branch_count_; }
+  const branch_id_t* branches() const { return branches_; }
+  const branch_id_t* paired_branch() const { return paired_; }
+  const function_id_t* branch_function() const { return function_; }
+
+  // The successors of branch 'b' in the thinned CFG are [*begin, *end),
+  // and its predecessors likewise.
+  void Successors(branch_id_t b, const branch_id_t** begin, const branch_id_t** end) const {
+    *begin = cfg_targets_ + cfg_offsets_[b];
+    *end = cfg_targets_ + cfg_offsets_[b + 1];
+  }
+  void Predecessors(branch_id_t b, const branch_id_t** begin, const branch_id_t** end) const {
+    *begin = rev_targets_ + rev_offsets_[b];
+    *end = rev_targets_ + rev_offsets_[b + 1];
+  }
+
+ private:
+  struct Header {
+    char magic[8];
+    unsigned int version;
+    unsigned int reserved;
+    unsigned long long num_functions;
+    unsigned long long num_branches;
+    unsigned long long max_branch;
+    unsigned long long num_edges;
+  };
+
+  static const unsigned int kVersion = 1;
+
+  MappedFile file_;
+  string built_;  // The bundle, when built in memory.
+
+  const Header* header_;
+  const function_id_t* branch_count_;
+  const branch_id_t* branches_;
+  const branch_id_t* paired_;
+  const function_id_t* function_;
+  const size_t* cfg_offsets_;
+  const branch_id_t* cfg_targets_;
+  const size_t* rev_offsets_;
+  const branch_id_t* rev_targets_;
+
+  // Points the arrays into the bundle at 'data', checking it.
+  bool View(const char* data, size_t len);
+
+  // Not copyable.
+  ProgramMetadata(const ProgramMetadata&);
+  void operator=(const ProgramMetadata&);
+};
+
+}  // namespace crest
+
+#endif  // BASE_PROGRAM_METADATA_H__
@@ -0,0 +1,128 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <utility>
+
+#include "base/query_cache.h"
+
+using std::make_pair;
+using std::sort;
+using std::unique;
+
+namespace crest {
+
+size_t QueryCache::KeyHash::operator()(const Key& key) const {
+  // FNV-1a over the ids.
+  size_t h = 2166136261u;
+  for (size_t i = 0; i < key.size(); i++) {
+    h = (h ^ key[i]) * 16777619u;
+  }
+  return h;
+}
+
+QueryCache::QueryCache(size_t max_entries)
+  : max_entries_(max_entries), enabled_(true), num_cores_(0),
+    num_hits_(0), num_core_hits_(0), num_misses_(0), num_flushes_(0) { }
+
+void QueryCache::Canonicalize(const map<var_t,type_t>& vars,
+                              const vector<const SymbolicPred*>& constraints,
+                              vector<unsigned>* ids, Key* key) {
+  MaybeFlush();
+
+  ids->clear();
+  string s;
+  for (size_t i = 0; i < constraints.size(); i++) {
+    s.clear();
+    constraints[i]->Serialize(&s);
+    const SymbolicExpr& e = constraints[i]->expr();
+    for (SymbolicExpr::TermIt j = e.terms().begin(); j != e.terms().end(); ++j) {
+      s.push_back(static_cast<char>(vars.find(j->first)->second));
+    }
+    map<string,unsigned>::iterator it =
+      ids_.insert(make_pair(s, static_cast<unsigned>(ids_.size()))).first;
+    ids->push_back(it->second);
+  }
+
+  *key = *ids;
+  sort(key->begin(), key->end());
+  key->erase(unique(key->begin(), key->end()), key->end());
+}
+
+QueryCache::result_t QueryCache::Lookup(const Key& key,
+                                        map<var_t,value_t>* soln) {
+  hash_map<Key,map<var_t,value_t>,KeyHash>::const_iterator it = sat_.find(key);
+  if (it != sat_.end()) {
+    *soln = it->second;
+    num_hits_++;
+    return SAT;
+  }
+  if (unsat_.find(key) != unsat_.end()) {
+    num_hits_++;
+    return UNSAT;
+  }
+  if (ContainsCore(key)) {
+    num_core_hits_++;
+    return UNSAT;
+  }
+  num_misses_++;
+  return MISS;
+}
+
+void QueryCache::InsertSat(const Key& key, const map<var_t,value_t>& soln) {
+  sat_[key] = soln;
+}
+
+void QueryCache::InsertUnsat(const Key& key, const Key& core) {
+  unsat_.insert(key);
+  if (!core.empty() && !ContainsCore(core)) {
+    cores_[core.front()].push_back(core);
+    num_cores_++;
+  }
+}
+
+bool QueryCache::ContainsCore(const Key& key) const {
+  typedef map<unsigned, vector<Key> >::const_iterator CoreIt;
+  for (size_t i = 0; i < key.size(); i++) {
+    CoreIt it = cores_.find(key[i]);
+    if (it == cores_.end())
+      continue;
+    for (size_t j = 0; j < it->second.size(); j++) {
+      const Key& core = it->second[j];
+      if (std::includes(key.begin() + i, key.end(), core.begin(), core.end()))
+        return true;
+    }
+  }
+  return false;
+}
+
+void QueryCache::MaybeFlush() {
+  if ((sat_.size() + unsat_.size() < max_entries_)
+      && (ids_.size() < max_entries_))
+    return;
+  // Constraint ids are dropped too, so only keys computed after the
+  // flush are valid.
+  ids_.clear();
+  sat_.clear();
+  unsat_.clear();
+  cores_.clear();
+  num_cores_ = 0;
+  num_flushes_++;
+}
+
+void QueryCache::PrintSummary(FILE* f) const {
+  size_t lookups = num_hits_ + num_core_hits_ + num_misses_;
+  fprintf(f, "Query cache: %zu lookups, %zu hits, %zu unsat-core hits, "
+          "%zu misses.\n", lookups, num_hits_, num_core_hits_, num_misses_);
+  fprintf(f, "  %zu sat, %zu unsat, %zu cores cached (%zu flushes).\n",
+          sat_.size(), unsat_.size(), num_cores_, num_flushes_);
+}
+
+}  // namespace crest
@@ -0,0 +1,98 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_QUERY_CACHE_H__
+#define BASE_QUERY_CACHE_H__
+
+#include <stddef.h>
+#include <stdio.h>
+#include <ext/hash_map>
+#include <ext/hash_set>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_predicate.h"
+
+using __gnu_cxx::hash_map;
+using __gnu_cxx::hash_set;
+using std::map;
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// Caches the results of solver queries across iterations.
+//
+// A query is canonicalized to the sorted set of its distinct constraints,
+// each interned to a small id.  (A constraint's id covers the types of
+// its variables, since their bounds are part of the query.)  The cache
+// keeps the model of every satisfiable query, and an unsatisfiable core
+// of every unsatisfiable one.  A query is answered without the solver if
+// it was seen before, or if it contains a known unsatisfiable core.
+class QueryCache {
+ public:
+  // A canonical query: sorted, distinct constraint ids.
+  typedef vector<unsigned> Key;
+
+  enum result_t { MISS, SAT, UNSAT };
+
+  // Forgets everything once 'max_entries' queries (or distinct
+  // constraints) are cached.  This happens only in Canonicalize, so a
+  // key stays valid until the next call to it.
+  explicit QueryCache(size_t max_entries);
+
+  // Computes the id of each constraint (in 'ids', in the order given)
+  // and the canonical key of the whole query.
+  void Canonicalize(const map<var_t,type_t>& vars,
+                    const vector<const SymbolicPred*>& constraints,
+                    vector<unsigned>* ids, Key* key);
+
+  // Looks up a query.  On a SAT hit, fills in 'soln' with its model.
+  result_t Lookup(const Key& key, map<var_t,value_t>* soln);
+
+  void InsertSat(const Key& key, const map<var_t,value_t>& soln);
+  // 'core' is an unsatisfiable subset of the query's constraint ids.
+  void InsertUnsat(const Key& key, const Key& core);
+
+  void PrintSummary(FILE* f) const;
+
+  bool enabled() const { return enabled_; }
+  void set_enabled(bool enabled) { enabled_ = enabled; }
+
+ private:
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  const size_t max_entries_;
+  bool enabled_;
+
+  map<string,unsigned> ids_;
+  hash_map<Key,map<var_t,value_t>,KeyHash> sat_;
+  hash_set<Key,KeyHash> unsat_;
+  // The unsatisfiable cores, indexed by their smallest constraint id.
+  map<unsigned, vector<Key> > cores_;
+  size_t num_cores_;
+
+  // Stats.
+  size_t num_hits_;
+  size_t num_core_hits_;
+  size_t num_misses_;
+  size_t num_flushes_;
+
+  bool ContainsCore(const Key& key) const;
+  void MaybeFlush();
+};
+
+}  // namespace crest
+
+#endif  // BASE_QUERY_CACHE_H__
@@ -0,0 +1,52 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "base/receive_schedule.h"
+
+namespace crest {
+
+const char kScheduleFile[] = "schedule";
+
+void WriteScheduleOrDie(const string& dir, const vector<ForcedMatch>& schedule) {
+  string file = dir + "/" + kScheduleFile;
+  FILE* f = fopen(file.c_str(), "w");
+  if (!f) {
+    fprintf(stderr, "Failed to open %s.\n", file.c_str());
+    perror("Error: ");
+    exit(-1);
+  }
+  for (size_t i = 0; i < schedule.size(); i++) {
+    fprintf(f, "%d %u %d\n", schedule[i].rank, schedule[i].index, schedule[i].source);
+  }
+  fclose(f);
+}
+
+void ReadSchedule(int rank, vector<int>* sources) {
+  sources->clear();
+  FILE* f = fopen(kScheduleFile, "r");
+  if (!f)
+    return;
+  int r, source;
+  unsigned index;
+  while (fscanf(f, "%d %u %d", &r, &index, &source) == 3) {
+    if (r != rank)
+      continue;
+    if (index >= sources->size())
+      sources->resize(index + 1, -1);
+    (*sources)[index] = source;
+  }
+  fclose(f);
+}
+
+}  // namespace crest
@@ -0,0 +1,65 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+
+#ifndef BASE_RECEIVE_SCHEDULE_H__
+#define BASE_RECEIVE_SCHEDULE_H__
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// A point-to-point receive in MPI_COMM_WORLD by the program under test
+// (see CR_MPI_Recv in libcrest), recorded so that run_crest can explore
+// the other sends a wildcard receive could have matched.
+//
+// The ranks keep Lamport clocks, advanced only by wildcard receives, and
+// every send carries its sender's clock.  If the receive R comes before
+// a send S, then S's clock is at least R's; so a send with a smaller
+// clock than R is not caused by R, and could have raced to match it.
+struct RecvEvent {
+  int rank;          // The receiving rank.
+  int source;        // The rank whose send was matched.
+  int tag;           // The tag of the matched send.
+  bool wildcard;     // Posted with MPI_ANY_SOURCE?
+  bool any_tag;      // Posted with MPI_ANY_TAG?
+  int send_clock;    // The sender's clock at the send.
+  int clock;         // The receiver's clock at the receive (counting the
+                     // tick of a wildcard receive).
+};
+
+// Forces wildcard receive number 'index' (counting from 0) of 'rank' to
+// match a send from 'source'.
+struct ForcedMatch {
+  int rank;
+  unsigned index;
+  int source;
+};
+
+// run_crest hands the forced matches of a run to the program in this
+// file in its working directory, one "rank index source" per line.
+extern const char kScheduleFile[];
+
+// Writes 'schedule' to kScheduleFile in 'dir' (an empty schedule forces
+// nothing).
+void WriteScheduleOrDie(const string& dir, const vector<ForcedMatch>& schedule);
+
+// Reads the sources forced for the wildcard receives of 'rank' from
+// kScheduleFile in the current directory: (*sources)[i] is the source of
+// receive i, or -1 if it is free.  Without the file, forces nothing.
+void ReadSchedule(int rank, vector<int>* sources);
+
+}  // namespace crest
+
+#endif  // BASE_RECEIVE_SCHEDULE_H__
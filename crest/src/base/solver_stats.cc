@@ -0,0 +1,55 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <time.h>
+
+#include "base/solver_stats.h"
+
+namespace crest {
+
+SolverStats::SolverStats()
+  : num_queries_(0), num_sat_(0), total_vars_(0), total_constraints_(0),
+    max_constraints_(0), build_secs_(0), check_secs_(0), max_check_secs_(0),
+    dump_(NULL) { }
+
+void SolverStats::AddQuery(size_t num_vars, size_t num_constraints,
+                           double build_secs, double check_secs, bool sat) {
+  num_queries_++;
+  if (sat)
+    num_sat_++;
+  total_vars_ += num_vars;
+  total_constraints_ += num_constraints;
+  if (num_constraints > max_constraints_)
+    max_constraints_ = num_constraints;
+  build_secs_ += build_secs;
+  check_secs_ += check_secs;
+  if (check_secs > max_check_secs_)
+    max_check_secs_ = check_secs;
+}
+
+void SolverStats::PrintSummary(FILE* f) const {
+  fprintf(f, "Solver: %zu queries (%zu sat, %zu unsat).\n",
+          num_queries_, num_sat_, num_queries_ - num_sat_);
+  if (num_queries_ == 0)
+    return;
+  fprintf(f, "  avg %.1f vars, avg %.1f constraints (max %zu).\n",
+          (double)total_vars_ / num_queries_,
+          (double)total_constraints_ / num_queries_, max_constraints_);
+  fprintf(f, "  build %.3fs, check %.3fs (max %.3fs per query).\n",
+          build_secs_, check_secs_, max_check_secs_);
+}
+
+double SolverStats::Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+}  // namespace crest
@@ -0,0 +1,62 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_SOLVER_STATS_H__
+#define BASE_SOLVER_STATS_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+namespace crest {
+
+// Counters for the queries sent to the constraint solver.
+//
+// The solver can also write a textual dump of every query to a separate
+// sink (see set_dump_file): the assertions, scope pushes and pops, and
+// the result and model of each check.  Nothing is dumped by default.
+class SolverStats {
+ public:
+  SolverStats();
+
+  // Records one query: the number of variables and constraints in it,
+  // the time spent building it and checking it, and its result.
+  void AddQuery(size_t num_vars, size_t num_constraints,
+                double build_secs, double check_secs, bool sat);
+
+  // Prints a summary of all queries recorded so far.
+  void PrintSummary(FILE* f) const;
+
+  FILE* dump_file() const { return dump_; }
+  void set_dump_file(FILE* f) { dump_ = f; }
+
+  size_t num_queries() const { return num_queries_; }
+  size_t num_sat() const { return num_sat_; }
+  double build_secs() const { return build_secs_; }
+  double check_secs() const { return check_secs_; }
+
+  // Seconds on a monotonic clock, for timing queries.
+  static double Now();
+
+ private:
+  size_t num_queries_;
+  size_t num_sat_;
+  size_t total_vars_;
+  size_t total_constraints_;
+  size_t max_constraints_;
+  double build_secs_;
+  double check_secs_;
+  double max_check_secs_;
+
+  FILE* dump_;
+};
+
+}  // namespace crest
+
+#endif  // BASE_SOLVER_STATS_H__
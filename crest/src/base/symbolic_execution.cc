@@ -12,13 +12,14 @@
 #include <stdio.h>
 
 #include "base/symbolic_execution.h"
+#include "base/varint.h"
 
 namespace crest {
 
-SymbolicExecution::SymbolicExecution() { }
+SymbolicExecution::SymbolicExecution() : has_coverage_(false) { }
 
 SymbolicExecution::SymbolicExecution(bool pre_allocate)
-  : path_(pre_allocate) { }
+  : path_(pre_allocate), has_coverage_(false) { }
 
 SymbolicExecution::~SymbolicExecution() { }
 
@@ -26,6 +27,9 @@ void SymbolicExecution::Swap(SymbolicExecution& se) {
   vars_.swap(se.vars_);
   inputs_.swap(se.inputs_);
   path_.Swap(se.path_);
+  receives_.swap(se.receives_);
+  std::swap(has_coverage_, se.has_coverage_);
+  coverage_.swap(se.coverage_);
 }
 
 void SymbolicExecution::Serialize(string* s) const {
@@ -41,21 +45,68 @@ void SymbolicExecution::Serialize(string* s) const {
 
   // Write the path.
   path_.Serialize(s);
+
+  // Write the receives, if any.
+  if (receives_.empty())
+    return;
+  AppendVarint(s, receives_.size());
+  for (size_t i = 0; i < receives_.size(); i++) {
+    const RecvEvent& e = receives_[i];
+    AppendVarint(s, ZigZag(e.rank));
+    AppendVarint(s, ZigZag(e.source));
+    AppendVarint(s, ZigZag(e.tag));
+    s->push_back(static_cast<char>((e.wildcard ? 1 : 0) | (e.any_tag ? 2 : 0)));
+    AppendVarint(s, ZigZag(e.send_clock));
+    AppendVarint(s, ZigZag(e.clock));
+  }
 }
 
-bool SymbolicExecution::Parse(istream& s) {
+bool SymbolicExecution::Parse(ByteReader* r) {
   // Read the inputs.
   size_t len;
-  s.read((char*)&len, sizeof(len));
+  if (!r->Read(&len, sizeof(len)) || (len > r->remaining()))
+    return false;
   vars_.clear();
   inputs_.resize(len);
+  has_coverage_ = false;
+  coverage_.clear();
   for (size_t i = 0; i < len; i++) {
-    vars_[i] = static_cast<type_t>(s.get());
-    s.read((char*)&inputs_[i], sizeof(value_t));
+    // (Appending in order, so each insert is at the end.)
+    vars_.insert(vars_.end(), make_pair(static_cast<var_t>(i), static_cast<type_t>(r->Get())));
+    r->Read(&inputs_[i], sizeof(value_t));
   }
+  if (r->failed())
+    return false;
 
-  // Write the path.
-  return (path_.Parse(s) && !s.fail());
+  // Read the path.
+  receives_.clear();
+  if (!path_.Parse(r))
+    return false;
+
+  // Read the receives, if any.
+  if (r->remaining() == 0)
+    return true;
+  unsigned long long n;
+  if (!r->ReadVarint(&n) || (n > r->remaining()))
+    return false;
+  receives_.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    RecvEvent& e = receives_[i];
+    unsigned long long rank, source, tag, send_clock, clock;
+    if (!r->ReadVarint(&rank) || !r->ReadVarint(&source) || !r->ReadVarint(&tag))
+      return false;
+    int flags = r->Get();
+    if ((flags < 0) || !r->ReadVarint(&send_clock) || !r->ReadVarint(&clock))
+      return false;
+    e.rank = UnZigZag(rank);
+    e.source = UnZigZag(source);
+    e.tag = UnZigZag(tag);
+    e.wildcard = (flags & 1) != 0;
+    e.any_tag = (flags & 2) != 0;
+    e.send_clock = UnZigZag(send_clock);
+    e.clock = UnZigZag(clock);
+  }
+  return !r->failed();
 }
 
 }  // namespace crest
@@ -17,6 +17,8 @@
 #include <vector>
 
 #include "base/basic_types.h"
+#include "base/byte_reader.h"
+#include "base/receive_schedule.h"
 #include "base/symbolic_path.h"
 
 using std::istream;
@@ -35,20 +37,38 @@ class SymbolicExecution {
   void Swap(SymbolicExecution& se);
 
   void Serialize(string* s) const;
-  bool Parse(istream& s);
+  // Parses the execution from 'r', which can be discarded afterwards.
+  bool Parse(ByteReader* r);
 
   const map<var_t,type_t>& vars() const { return vars_; }
   const vector<value_t>& inputs() const { return inputs_; }
   const SymbolicPath& path() const      { return path_; }
 
+  // All the branches covered by the run, when run_crest has them from
+  // the shared coverage map (see base/coverage_map.h).  Not serialized.
+  bool has_coverage() const { return has_coverage_; }
+  const vector<branch_id_t>& coverage() const { return coverage_; }
+  vector<branch_id_t>* mutable_coverage() {
+    has_coverage_ = true;
+    return &coverage_;
+  }
+
+  // The receives of the run, in the order each rank made them.  (Written
+  // after the path, and absent from older executions.)
+  const vector<RecvEvent>& receives() const { return receives_; }
+
   map<var_t,type_t>* mutable_vars() { return &vars_; }
   vector<value_t>* mutable_inputs() { return &inputs_; }
   SymbolicPath* mutable_path() { return &path_; }
+  vector<RecvEvent>* mutable_receives() { return &receives_; }
 
  private:
   map<var_t,type_t>  vars_;
   vector<value_t> inputs_;
   SymbolicPath path_;  
+  vector<RecvEvent> receives_;
+  bool has_coverage_;
+  vector<branch_id_t> coverage_;
 };
 
 }  // namespace crest
@@ -10,13 +10,39 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+#include <new>
+#include "base/object_pool.h"
 #include "base/symbolic_expression.h"
 
 namespace crest {
 
-    typedef map<var_t,value_t>::iterator It;
-    typedef map<var_t,value_t>::const_iterator ConstIt;
+    typedef TermVector::iterator It;
+    typedef TermVector::const_iterator ConstIt;
+    typedef TermVector::Term Term;
 
+    namespace {
+        // Never destroyed: expressions may outlive static destructors.
+        ObjectPool* ExprPool() {
+            static ObjectPool* pool = new ObjectPool(sizeof(SymbolicExpr), 1024);
+            return pool;
+        }
+    }
+
+    void* SymbolicExpr::operator new(size_t size) {
+        if (size != sizeof(SymbolicExpr))
+            return ::operator new(size);
+        return ExprPool()->Allocate();
+    }
+
+    void SymbolicExpr::operator delete(void* p, size_t size) {
+        if (!p)
+            return;
+        if (size != sizeof(SymbolicExpr))
+            ::operator delete(p);
+        else
+            ExprPool()->Free(p);
+    }
 
     SymbolicExpr::~SymbolicExpr() { }
 
@@ -25,7 +51,7 @@ namespace crest {
     SymbolicExpr::SymbolicExpr(value_t c) : const_(c) { }
 
     SymbolicExpr::SymbolicExpr(value_t c, var_t v) : const_(0) {
-        coeff_[v] = c;
+        coeff_.push_back(Term(v, c));
     }
 
     SymbolicExpr::SymbolicExpr(const SymbolicExpr& e)
@@ -46,6 +72,14 @@ namespace crest {
         }
     }
 
+    fingerprint_t SymbolicExpr::Hash() const {
+        fingerprint_t h = MixFingerprint(0, const_);
+        for (ConstIt i = coeff_.begin(); i != coeff_.end(); ++i) {
+            h = MixFingerprint(MixFingerprint(h, i->first), i->second);
+        }
+        return h;
+    }
+
     bool SymbolicExpr::DependsOn(const map<var_t,type_t>& vars) const {
         for (ConstIt i = coeff_.begin(); i != coeff_.end(); ++i) {
             if (vars.find(i->first) != vars.end())
@@ -106,56 +140,118 @@ namespace crest {
     }
 
 
-    bool SymbolicExpr::Parse(istream& s) {
-        size_t len = static_cast<size_t>(s.get());
-        s.read((char*)&const_, sizeof(value_t));
-        if (s.fail())
+    bool SymbolicExpr::Parse(ByteReader* r) {
+        int len = r->Get();
+        if ((len < 0) || !r->Read(&const_, sizeof(value_t)))
             return false;
 
+        // The terms are written in order, so they can be appended as-is.
+        const char* p = r->View(len * (sizeof(var_t) + sizeof(value_t)));
+        if (!p)
+            return false;
         coeff_.clear();
-        for (size_t i = 0; i < len; i++) {
-            var_t v;
-            value_t c;
-            s.read((char*)&v, sizeof(v));
-            s.read((char*)&c, sizeof(c));
-            coeff_[v] = c;
+        coeff_.reserve(len);
+        for (int i = 0; i < len; i++) {
+            Term t;
+            memcpy(&t.first, p, sizeof(var_t));
+            p += sizeof(var_t);
+            memcpy(&t.second, p, sizeof(value_t));
+            p += sizeof(value_t);
+            if (coeff_.empty() || (coeff_.end()[-1].first < t.first)) {
+                coeff_.push_back(t);
+            } else {
+                coeff_.Set(t);
+            }
         }
 
-        return !s.fail();
+        return true;
+    }
+
+
+    bool SymbolicExpr::Scan(ByteReader* r, fingerprint_t* hash) {
+        int len = r->Get();
+        value_t c;
+        if ((len < 0) || !r->Read(&c, sizeof(value_t)))
+            return false;
+        const char* p = r->View(len * (sizeof(var_t) + sizeof(value_t)));
+        if (!p)
+            return false;
+
+        // As in Hash().
+        fingerprint_t h = MixFingerprint(0, c);
+        var_t prev = 0;
+        for (int i = 0; i < len; i++) {
+            var_t v;
+            value_t a;
+            memcpy(&v, p, sizeof(var_t));
+            p += sizeof(var_t);
+            memcpy(&a, p, sizeof(value_t));
+            p += sizeof(value_t);
+            if ((i > 0) && !(prev < v))
+                return false;
+            prev = v;
+            h = MixFingerprint(MixFingerprint(h, v), a);
+        }
+        *hash = h;
+        return true;
     }
 
 
     const SymbolicExpr& SymbolicExpr::operator+=(const SymbolicExpr& e) {
+        if (&e == this)
+            return (*this *= 2);
         const_ += e.const_;
-        for (ConstIt i = e.coeff_.begin(); i != e.coeff_.end(); ++i) {
-            It j = coeff_.find(i->first);
-            if (j == coeff_.end()) {
-                coeff_.insert(*i);
-            } else {
-                j->second += i->second;
-                if (j->second == 0) {
-                    coeff_.erase(j);
-                }
-            }
-        }
+        AddTerms(e, 1);
         return *this;
     }
 
 
     const SymbolicExpr& SymbolicExpr::operator-=(const SymbolicExpr& e) {
+        if (&e == this)
+            return (*this *= 0);
         const_ -= e.const_;
-        for (ConstIt i = e.coeff_.begin(); i != e.coeff_.end(); ++i) {
-            It j = coeff_.find(i->first);
-            if (j == coeff_.end()) {
-                coeff_[i->first] = -i->second;
+        AddTerms(e, -1);
+        return *this;
+    }
+
+
+    // Adds 'sign' times the terms of 'e' to ours.  Both lists are sorted,
+    // so they are merged from the back into our (grown) storage, and the
+    // terms that cancel out are then squeezed out.
+    void SymbolicExpr::AddTerms(const SymbolicExpr& e, value_t sign) {
+        const size_t n = coeff_.size();
+        const size_t m = e.coeff_.size();
+        if (m == 0)
+            return;
+
+        coeff_.resize(n + m);
+        Term* a = coeff_.begin();
+        const Term* b = e.coeff_.begin();
+        size_t i = n, j = m, k = n + m;
+        while (j > 0) {
+            if ((i > 0) && (a[i-1].first > b[j-1].first)) {
+                a[--k] = a[--i];
+            } else if ((i > 0) && (a[i-1].first == b[j-1].first)) {
+                --k;
+                a[k].first = a[i-1].first;
+                a[k].second = a[i-1].second + sign * b[j-1].second;
+                --i;
+                --j;
             } else {
-                j->second -= i->second;
-                if (j->second == 0) {
-                    coeff_.erase(j);
-                }
+                --k;
+                a[k].first = b[j-1].first;
+                a[k].second = sign * b[j-1].second;
+                --j;
             }
         }
-        return *this;
+
+        // Now a[0..i) and a[k..n+m) hold the sum.
+        size_t w = i;
+        for (size_t r = k; r < n + m; r++) {
+            if (a[r].second != 0)
+                a[w++] = a[r];
+        }
+        coeff_.resize(w);
     }
 
 
@@ -18,6 +18,8 @@
 #include <string>
 
 #include "base/basic_types.h"
+#include "base/byte_reader.h"
+#include "base/term_vector.h"
 
 using std::istream;
 using std::map;
@@ -44,16 +46,31 @@ class SymbolicExpr {
   // Desctructor.
   ~SymbolicExpr();
 
+  // Expressions are allocated from a pool (see base/object_pool.h), as
+  // the interpreter creates and frees them on nearly every operation.
+  // (Any other size, as of a derived class, comes from the heap, and is
+  // returned there.)
+  static void* operator new(size_t size);
+  static void operator delete(void* p, size_t size);
+
   void Negate();
   bool IsConcrete() const { return coeff_.empty(); }
   size_t Size() const { return (1 + coeff_.size()); }
   void AppendVars(set<var_t>* vars) const;
+
+  // A hash of the expression.  Equal expressions have equal hashes.
+  fingerprint_t Hash() const;
   bool DependsOn(const map<var_t,type_t>& vars) const;
 
   void AppendToString(string* s, int tp='i') const;
 
   void Serialize(string* s) const;
-  bool Parse(istream& s);
+  bool Parse(ByteReader* r);
+
+  // Reads past a serialized expression without building it, setting
+  // 'hash' to its Hash().  Returns false if it is malformed, or if its
+  // terms are out of order (so that only Parse can tell its hash).
+  static bool Scan(ByteReader* r, fingerprint_t* hash);
 
   // Arithmetic operators.
   const SymbolicExpr& operator+=(const SymbolicExpr& e);
@@ -65,12 +82,14 @@ class SymbolicExpr {
 
   // Accessors.
   value_t const_term() const { return const_; }
-  const map<var_t,value_t>& terms() const { return coeff_; }
-  typedef map<var_t,value_t>::const_iterator TermIt;
+  const TermVector& terms() const { return coeff_; }
+  typedef TermVector::const_iterator TermIt;
 
  //private:
   value_t const_;
-  map<var_t,value_t> coeff_;
+  TermVector coeff_;
+
+  void AddTerms(const SymbolicExpr& e, value_t sign);
 };
 
 }  // namespace crest
@@ -17,6 +17,7 @@
 #include <cstring>
 
 #include "base/symbolic_interpreter.h"
+#include "base/varint.h"
 #include "base/yices_solver.h"
 
 using std::make_pair;
@@ -29,20 +30,26 @@ using std::vector;
 #define IFDEBUG(x)
 #endif
 
+#ifdef CREST_TRACE
+#define IFTRACE(x) x
+#else
+#define IFTRACE(x)
+#endif
+
 
 namespace crest {
 
-    typedef map<addr_t,SymbolicExpr*>::const_iterator ConstMemIt;
+    typedef vector<SymbolicMemory::Entry>::const_iterator ConstMemIt;
 
 
     SymbolicInterpreter::SymbolicInterpreter()
-        : pred_(NULL), ex_(true), num_inputs_(0) {
+        : pred_(NULL), recording_(false), ex_(true), num_inputs_(0) {
             stack_.reserve(16);
             state_id = 0;
         }
 
     SymbolicInterpreter::SymbolicInterpreter(const vector<value_t>& input)
-        : pred_(NULL), ex_(true) {
+        : pred_(NULL), recording_(false), ex_(true) {
             stack_.reserve(16);
             ex_.mutable_inputs()->assign(input.begin(), input.end());
             state_id = 0;
@@ -51,7 +58,9 @@ namespace crest {
     void SymbolicInterpreter::DumpMemory() {
         FILE *tr;
         tr = fopen("trace.txt","a");
-        for (ConstMemIt i = mem_.begin(); i != mem_.end(); ++i) {
+        vector<SymbolicMemory::Entry> mem;
+        mem_.Sorted(&mem);
+        for (ConstMemIt i = mem.begin(); i != mem.end(); ++i) {
             string s;
             i->second->AppendToString(&s);
             fprintf(tr, "%lu: %s [%d]\n", i->first, s.c_str(), *(int*)(i->first));
@@ -71,9 +80,7 @@ namespace crest {
 
 
     void SymbolicInterpreter::ClearStack(id_t id) {
-        FILE *tr;
-        tr = fopen("trace.txt","a");
-        IFDEBUG(fprintf(tr, "clear\n"));
+        IFTRACE(trace_.Append(trace::CLEAR_STACK, id, 0, 0));
         for (vector<StackElem>::const_iterator it = stack_.begin(); it != stack_.end(); ++it) {
             delete it->expr;
         }
@@ -81,55 +88,46 @@ namespace crest {
         ClearPredicateRegister();
         return_value_ = false;
         IFDEBUG(DumpMemory());
-        fclose(tr);
     }
 
 
     void SymbolicInterpreter::Load(id_t id, addr_t addr, value_t value) {
-        FILE *tr;
-        tr = fopen("trace.txt","a");
-        IFDEBUG(fprintf(tr, "load %lu %lld\n", addr, value));
-        ConstMemIt it = mem_.find(addr);
-        if (it == mem_.end()) {
+        IFTRACE(trace_.Append(trace::LOAD, id, addr, value));
+        const SymbolicExpr* e = mem_.Find(addr);
+        if (e == NULL) {
             PushConcrete(value);
         } else {
-            PushSymbolic(new SymbolicExpr(*it->second), value);
+            PushSymbolic(new SymbolicExpr(*e), value);
         }
         ClearPredicateRegister();
         IFDEBUG(DumpMemory());
-        fclose(tr);
     }
 
 
     void SymbolicInterpreter::Store(id_t id, addr_t addr) {
-        FILE *tr;
-        tr = fopen("trace.txt","a");
-        IFDEBUG(fprintf(tr, "store %lu\n", addr));
+        IFTRACE(trace_.Append(trace::STORE, id, addr, 0));
         assert(stack_.size() > 0);
 
         const StackElem& se = stack_.back();
         if (se.expr) {
             if (!se.expr->IsConcrete()) {
-                mem_[addr] = se.expr;
+                delete mem_.Set(addr, se.expr);
             } else {
-                mem_.erase(addr);
+                delete mem_.Erase(addr);
                 delete se.expr;
             }
         } else {
-            mem_.erase(addr);
+            delete mem_.Erase(addr);
         }
 
         stack_.pop_back();
         ClearPredicateRegister();
         IFDEBUG(DumpMemory());
-        fclose(tr);
     }
 
 
     void SymbolicInterpreter::ApplyUnaryOp(id_t id, unary_op_t op, value_t value) {
-        FILE *tr;
-        tr = fopen("trace.txt","a");
-        IFDEBUG(fprintf(tr, "apply1 %d %lld\n", op, value));
+        IFTRACE(trace_.Append(trace::APPLY1, id, op, value));
         assert(stack_.size() >= 1);
         StackElem& se = stack_.back();
 
@@ -155,14 +153,11 @@ namespace crest {
 
         se.concrete = value;
         IFDEBUG(DumpMemory());
-        fclose(tr);
     }
 
 
     void SymbolicInterpreter::ApplyBinaryOp(id_t id, binary_op_t op, value_t value) {
-        FILE *tr;
-        tr = fopen("trace.txt","a");
-        IFDEBUG(fprintf(tr, "apply2 %d %lld\n", op, value));
+        IFTRACE(trace_.Append(trace::APPLY2, id, op, value));
         assert(stack_.size() >= 2);
         StackElem& a = *(stack_.rbegin()+1);
         StackElem& b = stack_.back();
@@ -219,7 +214,6 @@ namespace crest {
         stack_.pop_back();
         ClearPredicateRegister();
         IFDEBUG(DumpMemory());
-        fclose(tr);
     }
 
     void SymbolicInterpreter::FreeMap(map<addr_t,string*> z)
@@ -232,9 +226,7 @@ namespace crest {
     }
 
     void SymbolicInterpreter::ApplyCompareOp(id_t id, compare_op_t op, value_t value) {
-        FILE *tr;
-        tr = fopen("trace.txt","a");
-        IFDEBUG(fprintf(tr, "compare2 %d %lld\n", op, value));
+        IFTRACE(trace_.Append(trace::COMPARE, id, op, value));
         assert(stack_.size() >= 2);
         StackElem& a = *(stack_.rbegin()+1);
         StackElem& b = stack_.back();
@@ -266,7 +258,6 @@ namespace crest {
         a.concrete = value;
         stack_.pop_back();
         IFDEBUG(DumpMemory());
-        fclose(tr);
     }
 
     void SymbolicInterpreter::ClearAllMaps()
@@ -279,7 +270,9 @@ namespace crest {
     }
 
     void SymbolicInterpreter::Call(id_t id, function_id_t fid) {
-        ex_.mutable_path()->Push(kCallId);
+        IFTRACE(trace_.Append(trace::CALL, id, fid, 0));
+        if (recording_)
+            ex_.mutable_path()->Push(kCallId);
         ClearAllMaps();
         //names_.clear(); // so that the local variable names in the caller don't persist
         // names_typs_.clear(); // so that the local variable names in the caller don't persist
@@ -288,7 +281,9 @@ namespace crest {
 
 
     void SymbolicInterpreter::Return(id_t id) {
-        ex_.mutable_path()->Push(kReturnId);
+        IFTRACE(trace_.Append(trace::RETURN, id, 0, 0));
+        if (recording_)
+            ex_.mutable_path()->Push(kReturnId);
         ClearAllMaps();
 
         // There is either exactly one value on the stack -- the current function's
@@ -316,9 +311,7 @@ namespace crest {
 
 
     void SymbolicInterpreter::Branch(id_t id, branch_id_t bid, bool pred_value) {
-        FILE *tr;
-        tr = fopen("trace.txt","a");
-        IFDEBUG(fprintf(tr, "branch %d %d\n", bid, pred_value));
+        IFTRACE(trace_.Append(trace::BRANCH, id, bid, pred_value));
         assert(stack_.size() == 1);
         stack_.pop_back();
 
@@ -326,7 +319,18 @@ namespace crest {
             pred_->Negate();
         }
 
-        ex_.mutable_path()->Push(bid, pred_);
+        // Every source of symbolic values (an input, or a symbolic
+        // message) starts the path, so a symbolic branch before it can
+        // only come from one we missed.  Start the path there, rather
+        // than drop the constraint.
+        if (pred_ && !recording_)
+            recording_ = true;
+
+        if (recording_) {
+            ex_.mutable_path()->Push(bid, pred_);
+        } else {
+            ex_.mutable_path()->CoverPrefix(bid);
+        }
         pred_ = NULL;
         IFDEBUG(DumpMemory());
     }
@@ -340,8 +344,10 @@ namespace crest {
     value_t SymbolicInterpreter::NewInputTemp(type_t type, addr_t addr, value_t val) {
         static unsigned int ghatiya = 0;
         num_inputs_ = ghatiya;
-        mem_[addr] = new SymbolicExpr(1, num_inputs_);
+        recording_ = true;
+        delete mem_.Set(addr, new SymbolicExpr(1, num_inputs_));
         ex_.mutable_vars()->insert(make_pair(num_inputs_ ,type));
+        input_addrs_.push_back(addr);
 
         value_t ret = val;
         if (num_inputs_ < ex_.inputs().size()) {
@@ -359,8 +365,10 @@ namespace crest {
     value_t SymbolicInterpreter::NewInput(type_t type, addr_t addr) {
         static unsigned int ghatiya = 0;
         num_inputs_ = ghatiya;
-        mem_[addr] = new SymbolicExpr(1, num_inputs_);
+        recording_ = true;
+        delete mem_.Set(addr, new SymbolicExpr(1, num_inputs_));
         ex_.mutable_vars()->insert(make_pair(num_inputs_ ,type));
+        input_addrs_.push_back(addr);
 
         value_t ret = 0;
         if (num_inputs_ < ex_.inputs().size()) {
@@ -377,6 +385,34 @@ namespace crest {
     }
 
 
+    void SymbolicInterpreter::ResetInputs(const vector<value_t>& input) {
+        vector<value_t>* inputs = ex_.mutable_inputs();
+        vector<value_t> next(input);
+        // Inputs not covered by the new vector keep their current values.
+        for (size_t i = next.size(); i < input_addrs_.size(); i++) {
+            next.push_back((*inputs)[i]);
+        }
+        inputs->swap(next);
+
+        for (size_t i = 0; i < input_addrs_.size(); i++) {
+            addr_t addr = input_addrs_[i];
+            value_t val = (*inputs)[i];
+            switch (ex_.vars().find(i)->second) {
+                case types::U_CHAR:      *(unsigned char*)addr = val; break;
+                case types::CHAR:        *(char*)addr = val; break;
+                case types::U_SHORT:     *(unsigned short*)addr = val; break;
+                case types::SHORT:       *(short*)addr = val; break;
+                case types::U_INT:       *(unsigned int*)addr = val; break;
+                case types::INT:         *(int*)addr = val; break;
+                case types::U_LONG:      *(unsigned long*)addr = val; break;
+                case types::LONG:        *(long*)addr = val; break;
+                case types::U_LONG_LONG: *(unsigned long long*)addr = val; break;
+                case types::LONG_LONG:   *(long long*)addr = val; break;
+            }
+        }
+    }
+
+
     void SymbolicInterpreter::PushConcrete(value_t value) {
         PushSymbolic(NULL, value);
     }
@@ -405,6 +441,10 @@ namespace crest {
         names_trigger_[addr] = trigger;
     }
 
+    void SymbolicInterpreter::FlushTrace() {
+        IFTRACE(trace_.Flush());
+    }
+
     int foo(int state_id){
         FILE *f = fopen("state_id","w");
         fprintf(f,"%d\n",state_id-1);
@@ -460,7 +500,9 @@ namespace crest {
 
 
         foo(state_id);
-        for (ConstMemIt i = mem_.begin(); i != mem_.end(); ++i) {
+        vector<SymbolicMemory::Entry> mem;
+        mem_.Sorted(&mem);
+        for (ConstMemIt i = mem.begin(); i != mem.end(); ++i) {
             string s;
             it = names_.find(i->first);
             if (it == names_.end())
@@ -509,7 +551,7 @@ namespace crest {
             int tp = names_typs_.find(i->first)->second;
             string* trg = names_trigger_.find(i->first)->second;
             //fprintf("%s",i->second->coeff);
-            if (mem_.find(i->first) == mem_.end())
+            if (mem_.Find(i->first) == NULL)
 #ifdef PRINT_FOR_TOOL
                 if (tp == 105) // Integer
                 {
@@ -597,7 +639,7 @@ namespace crest {
     {
     int tp = names_typs_.find(i->first)->second;
     string* trg = names_trigger_.find(i->first)->second;
-    if (mem_.find(i->first) == mem_.end())
+    if (mem_.Find(i->first) == NULL)
 #ifdef PRINT_FOR_TOOL
 if (tp == 'i') // Integer
 fprintf(stderr, "%lu<%s>: {const=%d} [%d] {%s}\n", i->first, i->second->c_str(), *(int*)(i->first) , *(int*)(i->first), trg->c_str());
@@ -636,7 +678,9 @@ void SymbolicInterpreter::ApplyLogState_1(int x) {// aakanksha
     fp = fopen("local_var.txt","a");
     map<addr_t,string*>::const_iterator it;
     fprintf(fp, "\nLocation(State): %d, %d\n", x, id++);
-    for (ConstMemIt i = mem_.begin(); i != mem_.end(); ++i) {
+    vector<SymbolicMemory::Entry> mem;
+    mem_.Sorted(&mem);
+    for (ConstMemIt i = mem.begin(); i != mem.end(); ++i) {
         string s;
         it = names_.find(i->first);
         if (it == names_.end())
@@ -661,7 +705,7 @@ void SymbolicInterpreter::ApplyLogState_1(int x) {// aakanksha
     {
         int tp = names_typs_.find(i->first)->second;
         string* trg = names_trigger_.find(i->first)->second;
-        if (mem_.find(i->first) == mem_.end())
+        if (mem_.Find(i->first) == NULL)
 #ifdef PRINT_FOR_TOOL
             if (tp == 'i') // Integer
                 fprintf(fp, "%lu<%s>: {const=%d} [%d] {%s}\n", i->first, i->second->c_str(), *(int*)(i->first) , *(int*)(i->first), trg->c_str());
@@ -687,7 +731,9 @@ void SymbolicInterpreter::ApplyLogState_gdb(int x) {// aakanksha
     fp = fopen("logged_var.txt","a");
     map<addr_t,string*>::const_iterator it;
     fprintf(fp, "\nLocation(State): %d, %d\n", x, id++);
-    for (ConstMemIt i = mem_.begin(); i != mem_.end(); ++i) {
+    vector<SymbolicMemory::Entry> mem;
+    mem_.Sorted(&mem);
+    for (ConstMemIt i = mem.begin(); i != mem.end(); ++i) {
         string s;
         it = names_.find(i->first);
         if (it == names_.end())
@@ -715,7 +761,7 @@ void SymbolicInterpreter::ApplyLogState_gdb(int x) {// aakanksha
     {
         int tp = names_typs_.find(i->first)->second;
         string* trg = names_trigger_.find(i->first)->second;
-        if (mem_.find(i->first) == mem_.end())
+        if (mem_.Find(i->first) == NULL)
 #ifdef PRINT_FOR_TOOL
             if (tp == 'i') // Integer
                 fprintf(fp, "%lu<%s>: {const=%d} [%d] {%s}\n", i->first, i->second->c_str(), *(int*)(i->first) , *(int*)(i->first), trg->c_str());
@@ -741,10 +787,9 @@ void SymbolicInterpreter::ApplyLogPC(int x) {
     fprintf(tr, "\nLocation(PC): %d\n", x);//NO
     const SymbolicExecution& ex = execution();
     const SymbolicPath& path = ex.path();
-    const vector<SymbolicPred*> constraints = path.constraints();
-    for (size_t i = 0; i < constraints.size(); i++) {
+    for (size_t i = 0; i < path.num_constraints(); i++) {
         s.clear();
-        constraints[i]->AppendToString(&s);
+        path.constraint(i)->AppendToString(&s);
         fprintf(tr, "%s\n", s.c_str());
     }
 
@@ -762,10 +807,9 @@ void SymbolicInterpreter::ApplyLogPC_gdb(int x) {
     foo(state_id);
     const SymbolicExecution& ex = execution();
     const SymbolicPath& path = ex.path();
-    const vector<SymbolicPred*> constraints = path.constraints();
-    for (size_t i = 0; i < constraints.size(); i++) {
+    for (size_t i = 0; i < path.num_constraints(); i++) {
         s.clear();
-        constraints[i]->AppendToString(&s);
+        path.constraint(i)->AppendToString(&s);
         //fprintf(dp, "%s\n", s.c_str());
         fprintf(dp1, "%s\n", s.c_str());
     }
@@ -792,25 +836,20 @@ void SymbolicInterpreter::ApplyLogSpec(char *op,int *op1,int *op2) {
     int x=1;
     fprintf(tr, "\nLocation(PC): %d, %d\n", x, state_id++);
     SymbolicExpr *val1, *val2;
-    ConstMemIt it, it2;
     string s;
-    it = mem_.find((long unsigned int)op1);
-    if (it == mem_.end())
+    val1 = mem_.Find((long unsigned int)op1);
+    if (val1 == NULL)
     {
         SymbolicExpr s(*op1);
         val1 = &s;
     }
     else{
-        val1 = it->second;
-        it2 = mem_.find((long unsigned int)op2);
-        if (it2 == mem_.end())
+        val2 = mem_.Find((long unsigned int)op2);
+        if (val2 == NULL)
         {
             SymbolicExpr s(*op2);
             val2 = &s;
         }
-        else{
-            val2 = it2->second;
-        }
     }
     *val1 -= *val2 ;
     //int tp = names_typs_.find(op1)->second;
@@ -833,6 +872,94 @@ void SymbolicInterpreter::ApplyMPILog(char *msg) {
     fclose(tr);
 }
 
+void SymbolicInterpreter::SerializeMessage(addr_t addr, size_t count, size_t size, string* s) const {
+    // The number of symbolic elements, then the index and value of each.
+    size_t num_symbolic = 0;
+    for (size_t i = 0; i < count; i++) {
+        num_symbolic += (mem_.Find(addr + i * size) != NULL);
+    }
+    AppendVarint(s, num_symbolic);
+    for (size_t i = 0; (i < count) && (num_symbolic > 0); i++) {
+        const SymbolicExpr* e = mem_.Find(addr + i * size);
+        if (e) {
+            AppendVarint(s, i);
+            e->Serialize(s);
+            num_symbolic--;
+        }
+    }
+}
+
+void SymbolicInterpreter::MakeConcrete(addr_t addr, size_t count, size_t size) {
+    for (size_t i = 0; i < count; i++) {
+        delete mem_.Erase(addr + i * size);
+    }
+}
+
+bool SymbolicInterpreter::BindMessage(addr_t addr, size_t count, size_t size, const char* data, size_t len) {
+    // The receive overwrote the whole buffer.
+    MakeConcrete(addr, count, size);
+
+    ByteReader r(data, len);
+    unsigned long long num_symbolic, idx;
+    if (!r.ReadVarint(&num_symbolic))
+        return false;
+    bool bound = false;
+    for (size_t i = 0; i < num_symbolic; i++) {
+        SymbolicExpr* e = new SymbolicExpr();
+        if (!r.ReadVarint(&idx) || (idx >= count) || !e->Parse(&r)) {
+            fprintf(stderr, "Malformed symbolic message.\n");
+            delete e;
+            return false;
+        }
+        if (e->IsConcrete()) {
+            delete e;
+        } else {
+            delete mem_.Set(addr + idx * size, e);
+            bound = true;
+        }
+    }
+    if (bound)
+        recording_ = true;
+    return bound;
+}
+
+bool SymbolicInterpreter::BindSum(addr_t addr, size_t count, size_t size,
+                                  const vector<string>& messages, const vector<value_t>& concrete) {
+    MakeConcrete(addr, count, size);
+
+    // The sum of each element with any symbolic addend.
+    vector<SymbolicExpr*> sums(count, static_cast<SymbolicExpr*>(NULL));
+    SymbolicExpr e;
+    for (size_t m = 0; m < messages.size(); m++) {
+        ByteReader r(messages[m].data(), messages[m].size());
+        unsigned long long num_symbolic, idx;
+        if (!r.ReadVarint(&num_symbolic))
+            continue;
+        for (size_t i = 0; i < num_symbolic; i++) {
+            if (!r.ReadVarint(&idx) || (idx >= count) || !e.Parse(&r)) {
+                fprintf(stderr, "Malformed symbolic message.\n");
+                break;
+            }
+            if (!sums[idx])
+                sums[idx] = new SymbolicExpr(concrete[idx]);
+            *sums[idx] += e;
+        }
+    }
+
+    bool bound = false;
+    for (size_t i = 0; i < count; i++) {
+        if (sums[i] && !sums[i]->IsConcrete()) {
+            mem_.Set(addr + i * size, sums[i]);
+            bound = true;
+        } else {
+            delete sums[i];
+        }
+    }
+    if (bound)
+        recording_ = true;
+    return bound;
+}
+
 void SymbolicInterpreter::ApplyMPICommLog(mpi_call_t cid, int src, int dest) {
 
     FILE *tr;
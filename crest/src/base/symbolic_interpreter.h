@@ -17,11 +17,13 @@
 #include <map>
 #include <vector>
 
+#include "base/addr_map.h"
 #include "base/basic_types.h"
 #include "base/symbolic_execution.h"
 #include "base/symbolic_expression.h"
 #include "base/symbolic_path.h"
 #include "base/symbolic_predicate.h"
+#include "base/trace_writer.h"
 
 using __gnu_cxx::hash_map;
 using std::map;
@@ -29,6 +31,8 @@ using std::vector;
 
 namespace crest {
 
+typedef AddrMap<SymbolicExpr*> SymbolicMemory;
+
 class SymbolicInterpreter {
  public:
   SymbolicInterpreter();
@@ -57,6 +61,11 @@ class SymbolicInterpreter {
   value_t NewInput(type_t type, addr_t addr);
   value_t NewInputTemp(type_t type, addr_t addr, value_t val);
 
+  // Replaces the input vector of the execution (e.g. in a forked child
+  // of a fork server).  Symbolic inputs that the program has already
+  // read are overwritten in place with their new values.
+  void ResetInputs(const vector<value_t>& input);
+
   // Accessor for symbolic execution so far.
   const SymbolicExecution& execution() const { return ex_; }
 
@@ -64,6 +73,10 @@ class SymbolicInterpreter {
   void DumpMemory();
   void DumpPath();
 
+  // Writes out any buffered trace records (a no-op unless built with
+  // CREST_TRACE).
+  void FlushTrace();
+
   void CreateVarMap(addr_t addr, string* name, int tp, string* trigger);
   void ApplyLogState(int x, int r_w, int line, char* varname, int val, int* addr);  // aakanksha
   void print(int x, int r_w, int line, char* varname, int val, int* addr);          // aakanksha
@@ -77,6 +90,31 @@ class SymbolicInterpreter {
   void ApplyMPILog(char* msg);
   void ApplyMPICommLog(mpi_call_t cid, int src, int dest);
 
+  // Symbolic messages.  SerializeMessage appends the symbolic values of
+  // the 'count' elements of 'size' bytes at 'addr' (the buffer of an
+  // MPI send) to 's'.  BindMessage gives the elements at 'addr' (the
+  // buffer of the matching receive, just overwritten) the values in
+  // 'data' from the sending rank, and makes the rest concrete.  Input
+  // variables are numbered alike in every rank, so the expressions mean
+  // the same on both sides.  Returns true if any value is symbolic,
+  // which starts the path (as a symbolic input would).
+  void SerializeMessage(addr_t addr, size_t count, size_t size, string* s) const;
+  bool BindMessage(addr_t addr, size_t count, size_t size, const char* data, size_t len);
+
+  // Collectives.  MakeConcrete drops the symbolic values of the 'count'
+  // elements at 'addr'.  BindSum gives element i at 'addr' (the result
+  // of an MPI_SUM reduction) the value concrete[i] plus the sum of the
+  // symbolic values of element i in 'messages' (each as written by
+  // SerializeMessage), where 'concrete' holds the sums of the elements
+  // that were concrete.  Returns true if any value is symbolic.
+  void MakeConcrete(addr_t addr, size_t count, size_t size);
+  bool BindSum(addr_t addr, size_t count, size_t size,
+               const vector<string>& messages, const vector<value_t>& concrete);
+  bool IsSymbolic(addr_t addr) const { return mem_.Find(addr) != NULL; }
+
+  // Records a receive of this rank (see base/receive_schedule.h).
+  void RecordReceive(const RecvEvent& e) { ex_.mutable_receives()->push_back(e); }
+
   int state_id;
 
  private:
@@ -94,8 +132,16 @@ class SymbolicInterpreter {
   // Is the top of the stack a function return value?
   bool return_value_;
 
+  // Has the path started?  Until the first symbolic input, the path
+  // only records which branches were covered (see
+  // SymbolicPath::CoverPrefix).
+  bool recording_;
+
   // Memory map.
-  map<addr_t, SymbolicExpr*> mem_;
+  SymbolicMemory mem_;
+
+  // Address of each symbolic input read so far.
+  vector<addr_t> input_addrs_;
 
   // Variable name map.
   map<addr_t, string*> names_;
@@ -105,6 +151,11 @@ class SymbolicInterpreter {
   // The symbolic execution (program path and inputs).
   SymbolicExecution ex_;
 
+#ifdef CREST_TRACE
+  // Binary trace of the interpreted operations.
+  TraceWriter trace_;
+#endif
+
   // Helper functions.
   inline void PushConcrete(value_t value);
   inline void PushSymbolic(SymbolicExpr* expr, value_t value);
@@ -8,17 +8,24 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
 // for details.
 
+#include <string.h>
+#include <limits>
+
 #include "base/symbolic_path.h"
+#include "base/varint.h"
+
+using std::numeric_limits;
 
 namespace crest {
 
-SymbolicPath::SymbolicPath() { }
+SymbolicPath::SymbolicPath() : indexed_(false) { }
 
-SymbolicPath::SymbolicPath(bool pre_allocate) {
+SymbolicPath::SymbolicPath(bool pre_allocate) : indexed_(false) {
   if (pre_allocate) {
     // To cut down on re-allocation.
     branches_.reserve(4000000);
     constraints_idx_.reserve(50000);
+    raw_constraints_.reserve(50000);
     constraints_.reserve(50000);
   }
 }
@@ -31,7 +38,14 @@ SymbolicPath::~SymbolicPath() {
 void SymbolicPath::Swap(SymbolicPath& sp) {
   branches_.swap(sp.branches_);
   constraints_idx_.swap(sp.constraints_idx_);
+  raw_.swap(sp.raw_);
+  raw_constraints_.swap(sp.raw_constraints_);
   constraints_.swap(sp.constraints_);
+  prefix_covered_.swap(sp.prefix_covered_);
+  DropIndex();
+  sp.DropIndex();
+  deps_.Clear();
+  sp.deps_.Clear();
 }
 
 void SymbolicPath::Push(branch_id_t bid) {
@@ -40,56 +54,364 @@ void SymbolicPath::Push(branch_id_t bid) {
 
 void SymbolicPath::Push(branch_id_t bid, SymbolicPred* constraint) {
   if (constraint) {
+    Constraint c = { 0, 0, constraint->op(), 0 };
+    raw_constraints_.push_back(c);
     constraints_.push_back(constraint);
     constraints_idx_.push_back(branches_.size());
+    DropIndex();
   }
   branches_.push_back(bid);
 }
 
+void SymbolicPath::Append(SymbolicPath* sp) {
+  size_t offset = branches_.size();
+  branches_.insert(branches_.end(), sp->branches_.begin(), sp->branches_.end());
+  size_t raw_offset = raw_.size();
+  raw_.append(sp->raw_);
+  for (size_t i = 0; i < sp->constraints_.size(); i++) {
+    constraints_idx_.push_back(offset + sp->constraints_idx_[i]);
+    raw_constraints_.push_back(sp->raw_constraints_[i]);
+    raw_constraints_.back().pos += raw_offset;
+    constraints_.push_back(sp->constraints_[i]);
+  }
+  sp->constraints_idx_.clear();
+  sp->raw_.clear();
+  sp->raw_constraints_.clear();
+  sp->constraints_.clear();
+  if (sp->prefix_covered_.size() > prefix_covered_.size())
+    prefix_covered_.resize(sp->prefix_covered_.size(), false);
+  for (size_t i = 0; i < sp->prefix_covered_.size(); i++) {
+    if (sp->prefix_covered_[i])
+      prefix_covered_[i] = true;
+  }
+  DropIndex();
+  sp->DropIndex();
+  sp->deps_.Clear();
+}
+
+// The original format starts with the number of branches as a size_t.
+// The compact format starts with a size_t no path can have, then a
+// version byte.  (Version 1 had no prefix coverage.)
+static const size_t kCompactMarker = ~static_cast<size_t>(0);
+static const char kCompactVersion = 2;
+
+// Back-references shorter than this are written as single branches.
+static const size_t kMinCopy = 3;
+
+// Where to record the last position of branch 'bid', in a dense table.
+static inline size_t LastPosSlot(branch_id_t bid) {
+  return static_cast<size_t>(ZigZag(bid));
+}
+
 void SymbolicPath::Serialize(string* s) const {
-  typedef vector<SymbolicPred*>::const_iterator ConIt;
+  s->append((char*)&kCompactMarker, sizeof(kCompactMarker));
+  s->push_back(kCompactVersion);
+
+  // Write the prefix coverage, as the deltas between covered branch ids.
+  size_t num_prefix = 0;
+  for (size_t i = 0; i < prefix_covered_.size(); i++) {
+    num_prefix += prefix_covered_[i];
+  }
+  AppendVarint(s, num_prefix);
+  size_t prev_bid = 0;
+  for (size_t i = 0; i < prefix_covered_.size(); i++) {
+    if (prefix_covered_[i]) {
+      AppendVarint(s, i - prev_bid);
+      prev_bid = i;
+    }
+  }
+
+  // Write the path, as a sequence of tokens.  A literal token is a branch
+  // id, as its difference from the previous branch id.  A copy token
+  // repeats 'len' branches from 'dist' back (overlapping, for loops), at
+  // the last place the current branch appeared.
+  const size_t n = branches_.size();
+  AppendVarint(s, n);
+  vector<size_t> last_pos;  // One more than the last position; 0 if none.
+  branch_id_t prev = 0;
+  for (size_t i = 0; i < n; ) {
+    size_t slot = LastPosSlot(branches_[i]);
+    if (slot >= last_pos.size())
+      last_pos.resize(2 * slot + 1, 0);
 
-  // Write the path.
-  size_t len = branches_.size();
-  s->append((char*)&len, sizeof(len));
-  s->append((char*)&branches_.front(), branches_.size() * sizeof(branch_id_t));
+    size_t len = 0, dist = 0;
+    if (last_pos[slot]) {
+      dist = i + 1 - last_pos[slot];
+      while ((i + len < n) && (branches_[i + len] == branches_[i + len - dist]))
+        len++;
+    }
 
-  // Write the path constraints.
-  len = constraints_.size();
-  s->append((char*)&len, sizeof(len));
-  s->append((char*)&constraints_idx_.front(), constraints_.size() * sizeof(size_t));
-  for (ConIt i = constraints_.begin(); i != constraints_.end(); ++i) {
-    (*i)->Serialize(s);
+    if (len >= kMinCopy) {
+      AppendVarint(s, (static_cast<unsigned long long>(len) << 1) | 1);
+      AppendVarint(s, dist);
+      for (size_t j = i; j < i + len; j++) {
+        // Every branch in the copy appeared before, so its slot exists.
+        last_pos[LastPosSlot(branches_[j])] = j + 1;
+      }
+      i += len;
+      prev = branches_[i - 1];
+    } else {
+      long long delta = static_cast<long long>(branches_[i]) - prev;
+      AppendVarint(s, ZigZag(delta) << 1);
+      last_pos[slot] = i + 1;
+      prev = branches_[i];
+      i++;
+    }
+  }
+
+  // Write the path constraints: their (non-decreasing) indices as
+  // deltas, then the predicates.
+  AppendVarint(s, constraints_.size());
+  size_t prev_idx = 0;
+  for (size_t i = 0; i < constraints_idx_.size(); i++) {
+    AppendVarint(s, ZigZag(static_cast<long long>(constraints_idx_[i] - prev_idx)));
+    prev_idx = constraints_idx_[i];
+  }
+  for (size_t i = 0; i < constraints_.size(); i++) {
+    if (constraints_[i]) {
+      constraints_[i]->Serialize(s);
+    } else {
+      s->append(raw_, raw_constraints_[i].pos, raw_constraints_[i].len);
+    }
   }
 }
 
-bool SymbolicPath::Parse(istream& s) {
-  typedef vector<SymbolicPred*>::iterator ConIt;
+bool SymbolicPath::Parse(ByteReader* r) {
   size_t len;
 
   // Read the path.
-  s.read((char*)&len, sizeof(size_t));
+  if (!r->Read(&len, sizeof(size_t)))
+    return false;
+  prefix_covered_.clear();
+  bool compact = (len == kCompactMarker);
+  if (compact) {
+    int version = r->Get();
+    if ((version < 1) || (version > kCompactVersion))
+      return false;
+    if ((version >= 2) && !ParsePrefixCoverage(r))
+      return false;
+    if (!ParseCompactBranches(r))
+      return false;
+  } else {
+    if (!ParseFixedWidthBranches(r, len))
+      return false;
+  }
+
+  return ParseConstraints(r, compact);
+}
+
+bool SymbolicPath::ParseFixedWidthBranches(ByteReader* r, size_t len) {
+  if (len > r->remaining() / sizeof(branch_id_t))
+    return false;
+  // (Copied out, since the data need not be aligned.)
   branches_.resize(len);
-  s.read((char*)&branches_.front(), len * sizeof(branch_id_t));
-  if (s.fail())
+  return ((len == 0) || r->Read(&branches_.front(), len * sizeof(branch_id_t)));
+}
+
+bool SymbolicPath::ParsePrefixCoverage(ByteReader* r) {
+  unsigned long long n, delta;
+  if (!r->ReadVarint(&n) || (n > r->remaining()))
+    return false;
+  size_t bid = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (!r->ReadVarint(&delta))
+      return false;
+    bid += delta;
+    if (bid > static_cast<size_t>(numeric_limits<branch_id_t>::max()))
+      return false;
+    CoverPrefix(static_cast<branch_id_t>(bid));
+  }
+  return true;
+}
+
+bool SymbolicPath::ParseCompactBranches(ByteReader* r) {
+  unsigned long long n, token, dist;
+  if (!r->ReadVarint(&n))
     return false;
 
+  branches_.clear();
+  // (Not trusting 'n' with a huge allocation before any branches are read.)
+  branches_.reserve(std::min(n, 1ULL << 20));
+  branch_id_t prev = 0;
+  while (branches_.size() < n) {
+    if (!r->ReadVarint(&token))
+      return false;
+    if (token & 1) {
+      unsigned long long len = token >> 1;
+      if (!r->ReadVarint(&dist)
+          || (dist == 0) || (dist > branches_.size())
+          || (len > n - branches_.size())) {
+        return false;
+      }
+      // One at a time, since the copy may overlap itself.
+      for (size_t j = 0; j < len; j++) {
+        branches_.push_back(branches_[branches_.size() - dist]);
+      }
+      prev = branches_.back();
+    } else {
+      prev = static_cast<branch_id_t>(prev + UnZigZag(token >> 1));
+      branches_.push_back(prev);
+    }
+  }
+  return true;
+}
+
+bool SymbolicPath::ParseConstraints(ByteReader* r, bool compact) {
+  size_t len;
+
   // Clean up any existing path constraints.
   for (size_t i = 0; i < constraints_.size(); i++)
     delete constraints_[i];
+  constraints_.clear();
+  raw_.clear();
+  raw_constraints_.clear();
+  DropIndex();
+  deps_.Clear();
 
-  // Read the path constraints.
-  s.read((char*)&len, sizeof(size_t));
-  constraints_idx_.resize(len);
-  constraints_.resize(len);
-  s.read((char*)&constraints_idx_.front(), len * sizeof(size_t));
-  for (ConIt i = constraints_.begin(); i != constraints_.end(); ++i) {
-    *i = new SymbolicPred();
-    if (!(*i)->Parse(s))
+  // Read the path constraints.  (Each takes at least one byte, which
+  // bounds their number.)
+  if (compact) {
+    unsigned long long n, delta;
+    if (!r->ReadVarint(&n) || (n > r->remaining()))
+      return false;
+    len = n;
+    constraints_idx_.resize(len);
+    size_t prev_idx = 0;
+    for (size_t i = 0; i < len; i++) {
+      if (!r->ReadVarint(&delta))
+        return false;
+      prev_idx += UnZigZag(delta);
+      constraints_idx_[i] = prev_idx;
+    }
+  } else {
+    if (!r->Read(&len, sizeof(size_t))
+        || (len > r->remaining() / sizeof(size_t)))
       return false;
+    constraints_idx_.resize(len);
+    if (len > 0)
+      r->Read(&constraints_idx_.front(), len * sizeof(size_t));
+  }
+
+  // Scan the predicates, building none of them yet.  Their bytes are
+  // copied out, since the buffer they are read from (a mapped file, or a
+  // transport's) does not outlive the parse.
+  const char* start = r->View(0);
+  if (!start)
+    return false;
+  const size_t avail = r->remaining();
+  constraints_.resize(len, NULL);
+  raw_constraints_.resize(len);
+  size_t pos = 0;
+  for (size_t i = 0; i < len; i++) {
+    Constraint& c = raw_constraints_[i];
+    ByteReader cr(start + pos, avail - pos);
+    if (!SymbolicPred::Scan(&cr, &c.op, &c.expr_hash)) {
+      // Malformed, or with its terms out of order, so that only parsing
+      // can tell its fingerprint.  Build it now.
+      cr = ByteReader(start + pos, avail - pos);
+      constraints_[i] = new SymbolicPred();
+      if (!constraints_[i]->Parse(&cr))
+        return false;
+    }
+    c.pos = pos;
+    c.len = (avail - pos) - cr.remaining();
+    pos += c.len;
+  }
+  raw_.assign(start, pos);
+  r->View(pos);
+
+  return !r->failed();
+}
+
+void SymbolicPath::Materialize(size_t i) const {
+  const Constraint& c = raw_constraints_[i];
+  ByteReader r(raw_.data() + c.pos, c.len);
+  SymbolicPred* pred = new SymbolicPred();
+  // (It scanned cleanly, so it parses.)
+  bool ok = pred->Parse(&r);
+  assert(ok);
+  (void)ok;
+  constraints_[i] = pred;
+}
+
+fingerprint_t SymbolicPath::ConstraintFingerprint(size_t i, bool negated) const {
+  if (constraints_[i])
+    return negated ? constraints_[i]->NegatedFingerprint() : constraints_[i]->Fingerprint();
+  const Constraint& c = raw_constraints_[i];
+  // As in SymbolicPred::Fingerprint.
+  return MixFingerprint(c.expr_hash, negated ? NegateCompareOp(c.op) : c.op);
+}
+
+void SymbolicPath::ConstraintVars(size_t i, vector<var_t>* vars) const {
+  vars->clear();
+  if (constraints_[i]) {
+    const TermVector& terms = constraints_[i]->expr().terms();
+    for (TermVector::const_iterator j = terms.begin(); j != terms.end(); ++j) {
+      vars->push_back(j->first);
+    }
+    return;
   }
 
-  return !s.fail();
+  // The operator, the number of terms, the constant, then the terms (see
+  // SymbolicExpr::Serialize).
+  const char* p = raw_.data() + raw_constraints_[i].pos + 1;
+  int num_terms = static_cast<unsigned char>(*p);
+  p += 1 + sizeof(value_t);
+  vars->resize(num_terms);
+  for (int j = 0; j < num_terms; j++) {
+    memcpy(&(*vars)[j], p, sizeof(var_t));
+    p += sizeof(var_t) + sizeof(value_t);
+  }
+}
+
+void SymbolicPath::BuildIndex() const {
+  first_index_.clear();
+  prefix_fp_.resize(constraints_.size() + 1);
+  prefix_fp_[0] = 0;
+  for (size_t i = 0; i < constraints_.size(); i++) {
+    fingerprint_t fp = ConstraintFingerprint(i, false);
+    first_index_.insert(std::make_pair(fp, i));
+    prefix_fp_[i+1] = MixFingerprint(prefix_fp_[i], fp);
+  }
+  indexed_ = true;
+}
+
+void SymbolicPath::DropIndex() {
+  if (indexed_) {
+    first_index_.clear();
+    prefix_fp_.clear();
+    indexed_ = false;
+  }
+}
+
+bool SymbolicPath::HasEarlierDuplicate(size_t i) const {
+  if (!indexed_) BuildIndex();
+  FingerprintIndex::const_iterator it = first_index_.find(ConstraintFingerprint(i, false));
+  // (On a fingerprint collision, we may miss a duplicate.  That only
+  // costs a solver call.)
+  return ((it != first_index_.end()) && (it->second < i)
+          && constraint(it->second)->Equal(*constraint(i)));
+}
+
+bool SymbolicPath::HasEarlierNegation(size_t i) const {
+  if (!indexed_) BuildIndex();
+  FingerprintIndex::const_iterator it = first_index_.find(ConstraintFingerprint(i, true));
+  return ((it != first_index_.end()) && (it->second < i)
+          && constraint(it->second)->EqualNegation(*constraint(i)));
+}
+
+fingerprint_t SymbolicPath::NegationFingerprint(size_t i) const {
+  if (!indexed_) BuildIndex();
+  return MixFingerprint(prefix_fp_[i], ConstraintFingerprint(i, true));
+}
+
+void SymbolicPath::DependentSlice(size_t i, vector<size_t>* slice, vector<var_t>* vars) const {
+  vector<var_t> cvars;
+  while (deps_.size() <= i) {
+    ConstraintVars(deps_.size(), &cvars);
+    deps_.Add(cvars);
+  }
+  deps_.Slice(i, slice, vars);
 }
 
 }  // namespace crest
@@ -11,17 +11,24 @@
 #ifndef BASE_SYMBOLIC_PATH_H__
 #define BASE_SYMBOLIC_PATH_H__
 
+#include <assert.h>
 #include <algorithm>
+#include <ext/hash_map>
 #include <istream>
 #include <ostream>
+#include <string>
 #include <vector>
 
 #include "base/basic_types.h"
+#include "base/byte_reader.h"
+#include "base/dependency_index.h"
 #include "base/symbolic_predicate.h"
 #include <stdio.h>
 
+using __gnu_cxx::hash_map;
 using std::istream;
 using std::ostream;
+using std::string;
 using std::swap;
 using std::vector;
 
@@ -37,17 +44,107 @@ class SymbolicPath {
 
   void Push(branch_id_t bid);
   void Push(branch_id_t bid, SymbolicPred* constraint);
+
+  // Marks 'bid' as covered before the path began.  (The interpreter only
+  // starts the path at the first symbolic input; before that, it keeps
+  // just the set of branches covered, which is all the search needs.)
+  void CoverPrefix(branch_id_t bid) {
+    assert(bid >= 0);
+    if (static_cast<size_t>(bid) >= prefix_covered_.size())
+      prefix_covered_.resize(2 * bid + 1, false);
+    prefix_covered_[bid] = true;
+  }
+
+  // Appends 'sp' to the end of this path, taking ownership of its
+  // constraints (which leaves 'sp' with none).
+  void Append(SymbolicPath* sp);
+
+  // Writes the path in the compact format: branch ids are delta- and
+  // varint-encoded, and repeats of earlier stretches of the path (as
+  // from loops) become back-references.  Parse also reads the original
+  // fixed-width format.
   void Serialize(string* s) const;
-  bool Parse(istream& s);
+  bool Parse(ByteReader* r);
 
   const vector<branch_id_t>& branches() const { return branches_; }
-  const vector<SymbolicPred*>& constraints() const { return constraints_; }
   const vector<size_t>& constraints_idx() const { return constraints_idx_; }
 
+  // The path constraints.  A parsed path keeps each one serialized until
+  // it is first asked for, so a search builds only the predicates it
+  // solves with.
+  size_t num_constraints() const { return constraints_.size(); }
+  SymbolicPred* constraint(size_t i) const {
+    if (!constraints_[i])
+      Materialize(i);
+    return constraints_[i];
+  }
+
+  // Indexed by branch id (and possibly shorter than the number of
+  // branches).
+  const vector<bool>& prefix_covered() const { return prefix_covered_; }
+
+  // Is some constraint before the i-th identical to it (so that the
+  // negated i-th constraint is unsatisfiable with its prefix)?
+  bool HasEarlierDuplicate(size_t i) const;
+  // Is some constraint before the i-th its negation?
+  bool HasEarlierNegation(size_t i) const;
+
+  // A fingerprint of the query "constraints [0..i-1] and the negation of
+  // constraint i", for recognizing the same query across executions.
+  fingerprint_t NegationFingerprint(size_t i) const;
+
+  // Fills 'slice' with the indices of the constraints among [0..i] that
+  // constraint i depends on, and 'vars' with their variables (see
+  // base/dependency_index.h).
+  void DependentSlice(size_t i, vector<size_t>* slice, vector<var_t>* vars) const;
+
  private:
   vector<branch_id_t> branches_;
   vector<size_t> constraints_idx_;
-  vector<SymbolicPred*> constraints_;
+  vector<bool> prefix_covered_;
+
+  // Each constraint, with where a parsed one is serialized in raw_ (and
+  // its operator and expression hash, read when scanning it, for the
+  // fingerprint index).  The predicate is NULL until built.  (Pushed
+  // constraints are built from the start, and have no bytes.)
+  struct Constraint {
+    size_t pos;
+    size_t len;
+    compare_op_t op;
+    fingerprint_t expr_hash;
+  };
+  string raw_;
+  vector<Constraint> raw_constraints_;
+  mutable vector<SymbolicPred*> constraints_;
+
+  // Builds constraint i from its bytes.
+  void Materialize(size_t i) const;
+  // The fingerprint of constraint i (or of its negation), built or not.
+  fingerprint_t ConstraintFingerprint(size_t i, bool negated) const;
+  // Sets 'vars' to the variables of constraint i, built or not.
+  void ConstraintVars(size_t i, vector<var_t>* vars) const;
+
+  // An index of the constraints by fingerprint, built on first use (and
+  // dropped when the constraints change).  'first_index_' maps each
+  // fingerprint to the first constraint with it, and 'prefix_fp_[i]' is
+  // the fingerprint of constraints [0..i-1].
+  typedef hash_map<fingerprint_t,size_t,FingerprintHash> FingerprintIndex;
+  mutable bool indexed_;
+  mutable FingerprintIndex first_index_;
+  mutable vector<fingerprint_t> prefix_fp_;
+
+  void BuildIndex() const;
+  void DropIndex();
+
+  // The dependencies between the constraints, extended as slices of
+  // longer prefixes are asked for.  (Appending constraints leaves it
+  // valid.)
+  mutable DependencyIndex deps_;
+
+  bool ParseFixedWidthBranches(ByteReader* r, size_t len);
+  bool ParseCompactBranches(ByteReader* r);
+  bool ParsePrefixCoverage(ByteReader* r);
+  bool ParseConstraints(ByteReader* r, bool compact);
 };
 
 }  // namespace crest
@@ -8,15 +8,41 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
 // for details.
 
+#include <new>
+
+#include "base/object_pool.h"
 #include "base/symbolic_predicate.h"
 
 namespace crest {
 
+namespace {
+// Never destroyed: predicates may outlive static destructors.
+ObjectPool* PredPool() {
+  static ObjectPool* pool = new ObjectPool(sizeof(SymbolicPred), 1024);
+  return pool;
+}
+}  // namespace
+
+void* SymbolicPred::operator new(size_t size) {
+  if (size != sizeof(SymbolicPred))
+    return ::operator new(size);
+  return PredPool()->Allocate();
+}
+
+void SymbolicPred::operator delete(void* p, size_t size) {
+  if (!p)
+    return;
+  if (size != sizeof(SymbolicPred))
+    ::operator delete(p);
+  else
+    PredPool()->Free(p);
+}
+
 SymbolicPred::SymbolicPred()
-  : op_(ops::EQ), expr_(new SymbolicExpr(0)) { }
+  : op_(ops::EQ), expr_(new SymbolicExpr(0)), expr_hash_(expr_->Hash()) { }
 
 SymbolicPred::SymbolicPred(compare_op_t op, SymbolicExpr* expr)
-  : op_(op), expr_(expr) { }
+  : op_(op), expr_(expr), expr_hash_(expr->Hash()) { }
 
 SymbolicPred::~SymbolicPred() {
   delete expr_;
@@ -40,13 +66,28 @@ void SymbolicPred::Serialize(string* s) const {
   expr_->Serialize(s);
 }
 
-bool SymbolicPred::Parse(istream& s) {
-  op_ = static_cast<compare_op_t>(s.get());
-  return (expr_->Parse(s) && !s.fail());
+bool SymbolicPred::Parse(ByteReader* r) {
+  op_ = static_cast<compare_op_t>(r->Get());
+  bool ok = (expr_->Parse(r) && !r->failed());
+  expr_hash_ = expr_->Hash();
+  return ok;
+}
+
+bool SymbolicPred::Scan(ByteReader* r, compare_op_t* op, fingerprint_t* expr_hash) {
+  int c = r->Get();
+  if (c < 0)
+    return false;
+  *op = static_cast<compare_op_t>(c);
+  return SymbolicExpr::Scan(r, expr_hash);
 }
 
 bool SymbolicPred::Equal(const SymbolicPred& p) const {
-  return ((op_ == p.op_) && (*expr_ == *p.expr_));
+  return ((op_ == p.op_) && (expr_hash_ == p.expr_hash_) && (*expr_ == *p.expr_));
+}
+
+bool SymbolicPred::EqualNegation(const SymbolicPred& p) const {
+  return ((op_ == NegateCompareOp(p.op_)) && (expr_hash_ == p.expr_hash_)
+          && (*expr_ == *p.expr_));
 }
 
 
@@ -31,13 +31,31 @@ class SymbolicPred {
   SymbolicPred(compare_op_t op, SymbolicExpr* expr);
   ~SymbolicPred();
 
+  // Allocated from a pool, like SymbolicExpr.
+  static void* operator new(size_t size);
+  static void operator delete(void* p, size_t size);
+
   void Negate();
   void AppendToString(string* s) const;
 
   void Serialize(string* s) const;
-  bool Parse(istream& s);
+  bool Parse(ByteReader* r);
+
+  // Reads past a serialized predicate without building it, setting 'op'
+  // and 'expr_hash' (see SymbolicExpr::Scan).
+  static bool Scan(ByteReader* r, compare_op_t* op, fingerprint_t* expr_hash);
 
   bool Equal(const SymbolicPred& p) const;
+  // Is this predicate the negation of 'p'?
+  bool EqualNegation(const SymbolicPred& p) const;
+
+  // A hash of the predicate (computed once, when it is created or
+  // parsed).  Equal predicates have equal fingerprints.
+  fingerprint_t Fingerprint() const { return MixFingerprint(expr_hash_, op_); }
+  // The fingerprint of the negation of this predicate.
+  fingerprint_t NegatedFingerprint() const {
+    return MixFingerprint(expr_hash_, NegateCompareOp(op_));
+  }
 
   void AppendVars(set<var_t>* vars) const {
     expr_->AppendVars(vars);
@@ -53,6 +71,7 @@ class SymbolicPred {
  private:
   compare_op_t op_;
   SymbolicExpr* expr_;
+  fingerprint_t expr_hash_;
 };
 
 }  // namespace crest
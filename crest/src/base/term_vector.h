@@ -0,0 +1,128 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_TERM_VECTOR_H__
+#define BASE_TERM_VECTOR_H__
+
+#include <stddef.h>
+#include <utility>
+
+#include "base/basic_types.h"
+
+namespace crest {
+
+// The (variable, coefficient) terms of a linear expression, sorted by
+// variable.  Up to kInline terms are stored in the object itself, so
+// copying a typical expression does not allocate; longer lists spill to
+// the heap.
+class TermVector {
+ public:
+  typedef std::pair<var_t,value_t> Term;
+  typedef Term* iterator;
+  typedef const Term* const_iterator;
+
+  static const size_t kInline = 4;
+
+  TermVector() : data_(inline_), size_(0), capacity_(kInline) { }
+
+  TermVector(const TermVector& v)
+    : data_(inline_), size_(0), capacity_(kInline) {
+    *this = v;
+  }
+
+  ~TermVector() {
+    if (data_ != inline_)
+      delete [] data_;
+  }
+
+  TermVector& operator=(const TermVector& v) {
+    if (this != &v) {
+      size_ = 0;
+      reserve(v.size_);
+      for (size_t i = 0; i < v.size_; i++) {
+        data_[i] = v.data_[i];
+      }
+      size_ = v.size_;
+    }
+    return *this;
+  }
+
+  bool operator==(const TermVector& v) const {
+    if (size_ != v.size_)
+      return false;
+    for (size_t i = 0; i < size_; i++) {
+      if (data_[i] != v.data_[i])
+        return false;
+    }
+    return true;
+  }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  void clear() { size_ = 0; }
+
+  // New terms (when growing) are left unset.
+  void resize(size_t n) {
+    reserve(n);
+    size_ = n;
+  }
+
+  void reserve(size_t n) {
+    if (n <= capacity_)
+      return;
+    Term* data = new Term[n];
+    for (size_t i = 0; i < size_; i++) {
+      data[i] = data_[i];
+    }
+    if (data_ != inline_)
+      delete [] data_;
+    data_ = data;
+    capacity_ = n;
+  }
+
+  // Appends a term, which must follow all the current terms in order.
+  void push_back(const Term& t) {
+    if (size_ == capacity_)
+      reserve(2 * capacity_);
+    data_[size_++] = t;
+  }
+
+  // Sets the coefficient of 't.first' to 't.second', keeping the terms
+  // sorted.  (Cheapest when 't' belongs at the end.)
+  void Set(const Term& t) {
+    size_t i = size_;
+    while ((i > 0) && (data_[i-1].first > t.first))
+      i--;
+    if ((i > 0) && (data_[i-1].first == t.first)) {
+      data_[i-1].second = t.second;
+      return;
+    }
+    push_back(t);
+    for (size_t j = size_ - 1; j > i; j--) {
+      data_[j] = data_[j-1];
+    }
+    data_[i] = t;
+  }
+
+ private:
+  Term* data_;
+  size_t size_;
+  size_t capacity_;
+  Term inline_[kInline];
+};
+
+}  // namespace crest
+
+#endif  // BASE_TERM_VECTOR_H__
@@ -0,0 +1,85 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "base/trace_writer.h"
+
+namespace crest {
+
+const char kTraceMagic[4] = { 'C', 'R', 'T', 'R' };
+
+namespace {
+
+void WriteOrDie(int fd, const char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("Failed to write trace");
+      exit(1);
+    }
+    buf += n;
+    len -= n;
+  }
+}
+
+}  // namespace
+
+TraceWriter::TraceWriter()
+  : buf_(new TraceRecord[kBufferRecords]), len_(0),
+    rank_(RankFromEnvironment()), fd_(-1) { }
+
+TraceWriter::~TraceWriter() {
+  Flush();
+  if (fd_ >= 0)
+    close(fd_);
+  delete [] buf_;
+}
+
+string TraceWriter::FileName(int rank) {
+  char buff[32];
+  snprintf(buff, sizeof(buff), "trace.%d.bin", rank);
+  return string(buff);
+}
+
+void TraceWriter::Open() {
+  string file = FileName(rank_);
+  fd_ = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    fprintf(stderr, "Failed to open %s.\n", file.c_str());
+    perror("Error: ");
+    exit(1);
+  }
+
+  TraceHeader h;
+  memcpy(h.magic, kTraceMagic, sizeof(h.magic));
+  h.version = kTraceVersion;
+  h.rank = rank_;
+  h.record_size = sizeof(TraceRecord);
+  WriteOrDie(fd_, (const char*)&h, sizeof(h));
+}
+
+void TraceWriter::Flush() {
+  if (len_ == 0)
+    return;
+  if (fd_ < 0)
+    Open();
+  WriteOrDie(fd_, (const char*)buf_, len_ * sizeof(TraceRecord));
+  len_ = 0;
+}
+
+}  // namespace crest
@@ -0,0 +1,92 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_TRACE_WRITER_H__
+#define BASE_TRACE_WRITER_H__
+
+#include <stddef.h>
+#include <string>
+
+#include "base/basic_types.h"
+
+using std::string;
+
+namespace crest {
+
+// Interpreter events recorded in a binary trace.
+namespace trace {
+enum event_t { LOAD = 0, STORE = 1, CLEAR_STACK = 2, APPLY1 = 3, APPLY2 = 4,
+               COMPARE = 5, BRANCH = 6, CALL = 7, RETURN = 8 };
+}  // namespace trace
+
+using trace::event_t;
+
+// A trace file is a TraceHeader followed by a sequence of fixed-size
+// TraceRecords.  The meaning of 'arg' depends on the event: the address
+// for LOAD/STORE, the operator for APPLY1/APPLY2/COMPARE, the branch ID
+// for BRANCH, and the function ID for CALL.
+struct TraceHeader {
+  char magic[4];
+  unsigned int version;
+  int rank;
+  unsigned int record_size;
+};
+
+struct TraceRecord {
+  unsigned int event;
+  id_t id;
+  addr_t arg;
+  value_t value;
+};
+
+extern const char kTraceMagic[4];
+static const unsigned int kTraceVersion = 1;
+
+// Appends TraceRecords to a per-rank file "trace.<rank>.bin" through a
+// large in-memory buffer, so that the file is opened once and written
+// only when the buffer fills up or Flush() is called (e.g. at exit).
+class TraceWriter {
+ public:
+  TraceWriter();
+  ~TraceWriter();
+
+  void Append(event_t event, id_t id, addr_t arg, value_t value) {
+    if (len_ == kBufferRecords)
+      Flush();
+    TraceRecord& r = buf_[len_++];
+    r.event = event;
+    r.id = id;
+    r.arg = arg;
+    r.value = value;
+  }
+
+  // Writes all buffered records to the trace file.
+  void Flush();
+
+  // The MPI rank used to name the trace file.  By default the rank is
+  // taken from the environment set up by mpirun (or 0).
+  void set_rank(int rank) { rank_ = rank; }
+
+  static string FileName(int rank);
+
+ private:
+  static const size_t kBufferRecords = 1 << 18;
+
+  TraceRecord* buf_;
+  size_t len_;
+  int rank_;
+  int fd_;
+
+  void Open();
+};
+
+}  // namespace crest
+
+#endif  // BASE_TRACE_WRITER_H__
@@ -0,0 +1,617 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+
+#include "base/byte_reader.h"
+#include "base/fork_server.h"
+#include "base/mapped_file.h"
+#include "base/transport.h"
+
+using std::copy;
+using std::ifstream;
+using std::ios;
+using std::ofstream;
+using std::replace;
+
+namespace crest {
+
+namespace transport {
+
+const char kKindEnvVar[] = "CREST_TRANSPORT";
+const char kAddressEnvVar[] = "CREST_TRANSPORT_ADDRESS";
+
+static const char* kKindNames[] = { "file", "socket", "shm" };
+
+bool ParseKind(const string& name, kind_t* kind) {
+  for (int i = 0; i < 3; i++) {
+    if (name == kKindNames[i]) {
+      *kind = static_cast<kind_t>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* KindName(kind_t kind) {
+  return kKindNames[kind];
+}
+
+string ExecutionFileName(int rank) {
+  char buff[64];
+  snprintf(buff, sizeof(buff), "szd_execution.%d", rank);
+  return string(buff);
+}
+
+}  // namespace transport
+
+using fork_server::ReadAll;
+using fork_server::WriteAll;
+
+namespace {
+
+using transport::ExecutionFileName;
+
+const char kInputFile[] = "input";
+
+// Marks an input or execution that did not fit in shared memory.
+const size_t kSpilled = static_cast<size_t>(-1);
+
+// Points the program we are about to start at a transport.
+void ExportTransport(transport::kind_t kind, const string& address) {
+  setenv(transport::kKindEnvVar, transport::KindName(kind), 1);
+  if (address.empty()) {
+    unsetenv(transport::kAddressEnvVar);
+  } else {
+    setenv(transport::kAddressEnvVar, address.c_str(), 1);
+  }
+}
+
+void Die(const char* what, const string& where) {
+  fprintf(stderr, "Failed to %s %s.\n", what, where.c_str());
+  perror("Error: ");
+  exit(-1);
+}
+
+// The path of 'file' in directory 'dir' ("" for the current directory).
+string InDir(const string& dir, const string& file) {
+  return dir.empty() ? file : (dir + "/" + file);
+}
+
+void ReadInputFile(vector<value_t>* input) {
+  ifstream in(kInputFile);
+  value_t val;
+  while (in >> val) {
+    input->push_back(val);
+  }
+  in.close();
+}
+
+void WriteInputFileOrDie(const string& dir, const vector<value_t>& input) {
+  string file = InDir(dir, kInputFile);
+  FILE* f = fopen(file.c_str(), "w");
+  if (!f)
+    Die("open", file);
+  for (size_t i = 0; i < input.size(); i++) {
+    fprintf(f, "%lld\n", input[i]);
+  }
+  fclose(f);
+}
+
+void WriteExecutionFile(int rank, const string& execution) {
+  ofstream out(ExecutionFileName(rank).c_str(), ios::out | ios::binary);
+  out.write(execution.data(), execution.size());
+  assert(!out.fail());
+  out.close();
+}
+
+bool AddExecution(int rank, const char* data, size_t len, MultiRankExecution* ex) {
+  ByteReader r(data, len);
+  SymbolicExecution rank_ex;
+  if (!rank_ex.Parse(&r))
+    return false;
+  ex->AddRank(rank, &rank_ex);
+  return true;
+}
+
+// Parses the execution of 'rank' from its file in 'dir', if there is
+// one, and adds it to 'ex'.
+bool AddExecutionFile(const string& dir, int rank, MultiRankExecution* ex) {
+  MappedFile file;
+  if (!file.Open(InDir(dir, ExecutionFileName(rank))))
+    return true;
+  return AddExecution(rank, file.data(), file.size(), ex);
+}
+
+//
+// Files.
+//
+
+class FileClient : public TransportClient {
+ public:
+  void ReadInput(vector<value_t>* input) { ReadInputFile(input); }
+  void WriteExecution(const string& execution) {
+    WriteExecutionFile(RankFromEnvironment(), execution);
+  }
+};
+
+class FileServer : public TransportServer {
+ public:
+  FileServer(int num_ranks, const string& dir)
+    : num_ranks_(num_ranks), dir_(dir) { }
+
+  void Export() const { ExportTransport(transport::FILES, ""); }
+
+  void SendInput(const vector<value_t>& input) {
+    // Executions left by an earlier run must not be mistaken for ours.
+    for (int i = 0; i < num_ranks_; i++) {
+      unlink(InDir(dir_, ExecutionFileName(i)).c_str());
+    }
+    WriteInputFileOrDie(dir_, input);
+  }
+
+  bool ReceiveExecution(MultiRankExecution* ex) {
+    ex->Clear();
+    for (int i = 0; i < num_ranks_; i++) {
+      if (!AddExecutionFile(dir_, i, ex))
+        return false;
+    }
+    return (ex->num_ranks() > 0);
+  }
+
+ private:
+  const int num_ranks_;
+  const string dir_;
+};
+
+//
+// Unix domain socket.  A request is a single byte:
+//
+//   kInputRequest      -- answered with the number of inputs (size_t) and
+//                         the inputs.
+//   kExecutionRequest  -- followed by the rank (int) and the serialized
+//                         execution, up to end-of-file.
+//
+
+const char kInputRequest = 'I';
+const char kExecutionRequest = 'E';
+
+int ConnectOrDie(const string& path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ((fd < 0) || connect(fd, (struct sockaddr*)&addr, sizeof(addr)))
+    Die("connect to", path);
+  return fd;
+}
+
+class SocketClient : public TransportClient {
+ public:
+  explicit SocketClient(const string& path) : path_(path) { }
+
+  void ReadInput(vector<value_t>* input) {
+    int fd = ConnectOrDie(path_);
+    size_t len;
+    if (!WriteAll(fd, &kInputRequest, 1) || !ReadAll(fd, &len, sizeof(len)))
+      Die("read input from", path_);
+    input->resize(len);
+    if ((len > 0) && !ReadAll(fd, &input->front(), len * sizeof(value_t)))
+      Die("read input from", path_);
+    close(fd);
+  }
+
+  void WriteExecution(const string& execution) {
+    int fd = ConnectOrDie(path_);
+    int rank = RankFromEnvironment();
+    if (!WriteAll(fd, &kExecutionRequest, 1)
+        || !WriteAll(fd, &rank, sizeof(rank))
+        || !WriteAll(fd, execution.data(), execution.size()))
+      Die("write execution to", path_);
+    close(fd);
+  }
+
+ private:
+  const string path_;
+};
+
+class SocketServer : public TransportServer {
+ public:
+  SocketServer(int num_ranks, const string& dir) : executions_(num_ranks) {
+    // In 'dir', so servers in different directories do not collide.  The
+    // program runs in 'dir', so it gets just the file name.
+    char buff[64];
+    snprintf(buff, sizeof(buff), "crest_socket.%d", (int)getpid());
+    address_ = buff;
+    path_ = InDir(dir, address_);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+
+    unlink(path_.c_str());
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((listen_fd_ < 0)
+        || bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr))
+        || listen(listen_fd_, SOMAXCONN))
+      Die("listen on", path_);
+    fcntl(listen_fd_, F_SETFL, O_NONBLOCK);
+  }
+
+  ~SocketServer() {
+    for (size_t i = 0; i < conns_.size(); i++) {
+      close(conns_[i].fd);
+    }
+    close(listen_fd_);
+    unlink(path_.c_str());
+  }
+
+  void SendInput(const vector<value_t>& input) {
+    input_ = input;
+    for (size_t i = 0; i < executions_.size(); i++) {
+      executions_[i].clear();
+    }
+  }
+
+  void Export() const { ExportTransport(transport::UNIX_SOCKET, address_); }
+
+  void WaitFor(const vector<int>& fds) {
+    for (;;) {
+      vector<struct pollfd> pfds(1 + conns_.size() + fds.size());
+      pfds[0].fd = listen_fd_;
+      for (size_t i = 0; i < conns_.size(); i++) {
+        pfds[1 + i].fd = conns_[i].fd;
+      }
+      for (size_t i = 0; i < fds.size(); i++) {
+        pfds[1 + conns_.size() + i].fd = fds[i];
+      }
+      for (size_t i = 0; i < pfds.size(); i++) {
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+      }
+
+      if (poll(&pfds.front(), pfds.size(), -1) < 0) {
+        if (errno == EINTR)
+          continue;
+        Die("poll", path_);
+      }
+
+      // Service the connections from the back, so that erasing a
+      // finished one does not disturb the indices still to visit.
+      for (size_t i = conns_.size(); i > 0; i--) {
+        if (pfds[i].revents && !Service(&conns_[i - 1])) {
+          close(conns_[i - 1].fd);
+          conns_.erase(conns_.begin() + (i - 1));
+        }
+      }
+      if (pfds[0].revents)
+        AcceptAll();
+
+      for (size_t i = pfds.size() - fds.size(); i < pfds.size(); i++) {
+        if (pfds[i].revents)
+          return;
+      }
+    }
+  }
+
+  bool ReceiveExecution(MultiRankExecution* ex) {
+    // The program has exited, so every connection it made is queued or
+    // open, and reading each to the end cannot block for long.
+    AcceptAll();
+    for (size_t i = 0; i < conns_.size(); i++) {
+      while (Service(&conns_[i])) { }
+      close(conns_[i].fd);
+    }
+    conns_.clear();
+
+    ex->Clear();
+    for (size_t i = 0; i < executions_.size(); i++) {
+      const string& data = executions_[i];
+      if (!data.empty() && !AddExecution(i, data.data(), data.size(), ex))
+        return false;
+    }
+    return (ex->num_ranks() > 0);
+  }
+
+ private:
+  struct Connection {
+    int fd;
+    string data;
+  };
+
+  string address_;
+  string path_;
+  int listen_fd_;
+  vector<Connection> conns_;
+  vector<value_t> input_;
+  // The serialized execution sent by each rank.
+  vector<string> executions_;
+
+  void AcceptAll() {
+    int fd;
+    while ((fd = accept(listen_fd_, NULL, NULL)) >= 0) {
+      Connection c;
+      c.fd = fd;
+      conns_.push_back(c);
+    }
+  }
+
+  // Reads what is available on a connection.  Returns false once the
+  // request on it is complete.
+  bool Service(Connection* c) {
+    char buff[1 << 16];
+    ssize_t n = read(c->fd, buff, sizeof(buff));
+    if ((n < 0) && (errno == EINTR))
+      return true;
+    if (n > 0) {
+      c->data.append(buff, n);
+      if (c->data[0] != kInputRequest)
+        return true;
+      // A client that has gone away must not kill us with SIGPIPE.
+      size_t len = input_.size();
+      if (send(c->fd, &len, sizeof(len), MSG_NOSIGNAL) == sizeof(len)) {
+        const char* p = reinterpret_cast<const char*>(len ? &input_.front() : NULL);
+        size_t left = len * sizeof(value_t);
+        ssize_t m;
+        while ((left > 0) && ((m = send(c->fd, p, left, MSG_NOSIGNAL)) > 0)) {
+          p += m;
+          left -= m;
+        }
+      }
+      return false;
+    }
+
+    // End-of-file (or error): the request is complete.
+    if ((c->data.size() > 1 + sizeof(int)) && (c->data[0] == kExecutionRequest)) {
+      int rank;
+      memcpy(&rank, c->data.data() + 1, sizeof(rank));
+      if ((rank >= 0) && (static_cast<size_t>(rank) < executions_.size())) {
+        executions_[rank] = c->data.substr(1 + sizeof(rank));
+      } else {
+        fprintf(stderr, "Ignoring execution from rank %d.\n", rank);
+      }
+    }
+    return false;
+  }
+};
+
+//
+// Shared memory.  The segment holds a ShmHeader and then, for each rank,
+// a ShmSlot followed by slot_size bytes of serialized execution.  Each
+// rank stamps its slot with the value of a shared counter when done, so
+// a slot with a non-zero 'seq' holds an execution.
+//
+
+const size_t kShmMaxInputs = 1 << 16;
+const size_t kShmSlotSize = 1 << 26;
+
+struct ShmHeader {
+  unsigned int num_slots;
+  unsigned int seq;
+  size_t slot_size;
+  size_t num_inputs;
+  value_t inputs[kShmMaxInputs];
+};
+
+struct ShmSlot {
+  size_t len;
+  unsigned int seq;
+};
+
+ShmSlot* SlotAt(ShmHeader* h, size_t i) {
+  char* base = reinterpret_cast<char*>(h + 1);
+  return reinterpret_cast<ShmSlot*>(base + i * (sizeof(ShmSlot) + h->slot_size));
+}
+
+class ShmClient : public TransportClient {
+ public:
+  explicit ShmClient(const string& name) : name_(name), h_(NULL) { }
+
+  ~ShmClient() {
+    if (h_)
+      munmap(h_, size_);
+  }
+
+  void ReadInput(vector<value_t>* input) {
+    Map();
+    if (h_->num_inputs == kSpilled) {
+      ReadInputFile(input);
+    } else {
+      input->assign(h_->inputs, h_->inputs + h_->num_inputs);
+    }
+  }
+
+  void WriteExecution(const string& execution) {
+    Map();
+    int rank = RankFromEnvironment();
+    if ((rank < 0) || (static_cast<unsigned int>(rank) >= h_->num_slots)) {
+      fprintf(stderr, "No slot in %s for rank %d.\n", name_.c_str(), rank);
+      exit(-1);
+    }
+
+    ShmSlot* slot = SlotAt(h_, rank);
+    if (execution.size() > h_->slot_size) {
+      WriteExecutionFile(rank, execution);
+      slot->len = kSpilled;
+    } else {
+      memcpy(slot + 1, execution.data(), execution.size());
+      slot->len = execution.size();
+    }
+    __sync_synchronize();
+    slot->seq = __sync_add_and_fetch(&h_->seq, 1);
+  }
+
+ private:
+  const string name_;
+  ShmHeader* h_;
+  size_t size_;
+
+  // Maps the segment on first use (possibly after a fork).
+  void Map() {
+    if (h_)
+      return;
+    int fd = shm_open(name_.c_str(), O_RDWR, 0);
+    struct stat st;
+    if ((fd < 0) || fstat(fd, &st))
+      Die("open", name_);
+    size_ = st.st_size;
+    void* p = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+      Die("map", name_);
+    h_ = static_cast<ShmHeader*>(p);
+  }
+};
+
+class ShmServer : public TransportServer {
+ public:
+  ShmServer(int num_ranks, const string& dir) : dir_(dir) {
+    // Named for 'dir' too, so servers in different directories do not
+    // collide.  (A name may have no other '/' than the first.)
+    char buff[64];
+    snprintf(buff, sizeof(buff), "/crest.%d", (int)getpid());
+    name_ = buff;
+    if (!dir.empty()) {
+      string suffix = "." + dir;
+      replace(suffix.begin(), suffix.end(), '/', '_');
+      name_ += suffix;
+    }
+
+    // The segment is sparse, so unused slot space costs nothing.
+    size_ = sizeof(ShmHeader) + num_ranks * (sizeof(ShmSlot) + kShmSlotSize);
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if ((fd < 0) || ftruncate(fd, size_))
+      Die("create", name_);
+    void* p = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+      Die("map", name_);
+
+    h_ = static_cast<ShmHeader*>(p);
+    h_->num_slots = num_ranks;
+    h_->slot_size = kShmSlotSize;
+  }
+
+  ~ShmServer() {
+    munmap(h_, size_);
+    shm_unlink(name_.c_str());
+  }
+
+  void Export() const { ExportTransport(transport::SHARED_MEMORY, name_); }
+
+  void SendInput(const vector<value_t>& input) {
+    for (size_t i = 0; i < h_->num_slots; i++) {
+      SlotAt(h_, i)->seq = 0;
+    }
+    h_->seq = 0;
+
+    if (input.size() > kShmMaxInputs) {
+      WriteInputFileOrDie(dir_, input);
+      h_->num_inputs = kSpilled;
+    } else {
+      copy(input.begin(), input.end(), h_->inputs);
+      h_->num_inputs = input.size();
+    }
+    __sync_synchronize();
+  }
+
+  bool ReceiveExecution(MultiRankExecution* ex) {
+    __sync_synchronize();
+    ex->Clear();
+    for (size_t i = 0; i < h_->num_slots; i++) {
+      ShmSlot* slot = SlotAt(h_, i);
+      if (!slot->seq)
+        continue;
+      bool ok = ((slot->len == kSpilled)
+                 ? AddExecutionFile(dir_, i, ex)
+                 : AddExecution(i, reinterpret_cast<const char*>(slot + 1), slot->len, ex));
+      if (!ok)
+        return false;
+    }
+    return (ex->num_ranks() > 0);
+  }
+
+ private:
+  const string dir_;
+  string name_;
+  size_t size_;
+  ShmHeader* h_;
+};
+
+}  // namespace
+
+TransportClient* TransportClient::FromEnvironment() {
+  transport::kind_t kind = transport::FILES;
+  const char* name = getenv(transport::kKindEnvVar);
+  if (name && !transport::ParseKind(name, &kind)) {
+    fprintf(stderr, "Unknown transport: %s.\n", name);
+    exit(-1);
+  }
+
+  const char* addr = getenv(transport::kAddressEnvVar);
+  if ((kind != transport::FILES) && !addr) {
+    fprintf(stderr, "No address for transport %s.\n", name);
+    exit(-1);
+  }
+
+  switch (kind) {
+  case transport::UNIX_SOCKET:
+    return new SocketClient(addr);
+  case transport::SHARED_MEMORY:
+    return new ShmClient(addr);
+  default:
+    return new FileClient();
+  }
+}
+
+TransportServer* TransportServer::Create(transport::kind_t kind, int num_ranks) {
+  return Create(kind, num_ranks, "");
+}
+
+TransportServer* TransportServer::Create(transport::kind_t kind, int num_ranks,
+                                         const string& dir) {
+  switch (kind) {
+  case transport::UNIX_SOCKET:
+    return new SocketServer(num_ranks, dir);
+  case transport::SHARED_MEMORY:
+    return new ShmServer(num_ranks, dir);
+  default:
+    return new FileServer(num_ranks, dir);
+  }
+}
+
+void TransportServer::WaitFor(const vector<int>& fds) {
+  vector<struct pollfd> pfds(fds.size());
+  for (size_t i = 0; i < fds.size(); i++) {
+    pfds[i].fd = fds[i];
+    pfds[i].events = POLLIN;
+    pfds[i].revents = 0;
+  }
+  while ((poll(&pfds.front(), pfds.size(), -1) < 0) && (errno == EINTR)) { }
+}
+
+}  // namespace crest
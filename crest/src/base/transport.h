@@ -0,0 +1,101 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_TRANSPORT_H__
+#define BASE_TRANSPORT_H__
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/multi_rank_execution.h"
+
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// A transport carries the input vector from run_crest to the program
+// under test, and the serialized SymbolicExecution back.  run_crest picks
+// the kind at runtime and passes it to the program in the environment
+// variables kKindEnvVar and kAddressEnvVar:
+//
+//   FILES         -- the file "input" and, for each rank, the file
+//                    "szd_execution.<rank>" (the default).
+//   UNIX_SOCKET   -- a Unix domain socket.  Every request is one short
+//                    connection, so processes forked by the fork server
+//                    can share the client.
+//   SHARED_MEMORY -- a POSIX shared memory segment holding the input and
+//                    one execution slot per MPI rank.  An input or an
+//                    execution too large for the segment spills over to
+//                    the files.
+namespace transport {
+
+enum kind_t { FILES = 0, UNIX_SOCKET = 1, SHARED_MEMORY = 2 };
+
+extern const char kKindEnvVar[];
+extern const char kAddressEnvVar[];
+
+// Converts between kinds and their names: "file", "socket", "shm".
+bool ParseKind(const string& name, kind_t* kind);
+const char* KindName(kind_t kind);
+
+// The file the FILES transport writes the execution of 'rank' to.
+string ExecutionFileName(int rank);
+
+}  // namespace transport
+
+// The end of a transport inside the program under test.
+class TransportClient {
+ public:
+  virtual ~TransportClient() { }
+
+  // The transport named in the environment.
+  static TransportClient* FromEnvironment();
+
+  virtual void ReadInput(vector<value_t>* input) = 0;
+  virtual void WriteExecution(const string& execution) = 0;
+};
+
+// The end of a transport inside run_crest.  Each server has its own
+// socket or segment (named for its directory and our pid), so several
+// can serve programs at once.
+class TransportServer {
+ public:
+  virtual ~TransportServer() { }
+
+  static TransportServer* Create(transport::kind_t kind, int num_ranks);
+
+  // As above, but the transport keeps its files (and socket) in 'dir',
+  // which is then the working directory of the program under test.
+  static TransportServer* Create(transport::kind_t kind, int num_ranks,
+                                 const string& dir);
+
+  // Sets the environment variables that point the program under test at
+  // this server.  Call in the child that is about to start the program.
+  virtual void Export() const = 0;
+
+  // Starts a new execution on the given input.
+  virtual void SendInput(const vector<value_t>& input) = 0;
+
+  // Services the transport until one of 'fds' becomes readable (or is
+  // closed).  Call while the program under test is running.
+  virtual void WaitFor(const vector<int>& fds);
+
+  // After the program under test has exited, parses and merges the
+  // executions sent by its ranks.  Returns false if none arrived (or
+  // one could not be parsed).
+  virtual bool ReceiveExecution(MultiRankExecution* ex) = 0;
+};
+
+}  // namespace crest
+
+#endif  // BASE_TRANSPORT_H__
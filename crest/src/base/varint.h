@@ -0,0 +1,45 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_VARINT_H__
+#define BASE_VARINT_H__
+
+#include <string>
+
+using std::string;
+
+namespace crest {
+
+// Variable-length integers, as in the serialized executions: seven bits
+// per byte, least significant first, with the high bit set on every byte
+// but the last.  (ByteReader::ReadVarint reads them.)
+
+inline void AppendVarint(string* s, unsigned long long v) {
+  while (v >= 0x80) {
+    s->push_back(static_cast<char>((v & 0x7F) | 0x80));
+    v >>= 7;
+  }
+  s->push_back(static_cast<char>(v));
+}
+
+// Maps small signed values to small unsigned ones: 0, -1, 1, -2, ... to
+// 0, 1, 2, 3, ...
+inline unsigned long long ZigZag(long long v) {
+  return ((static_cast<unsigned long long>(v) << 1)
+          ^ static_cast<unsigned long long>(v >> 63));
+}
+
+inline long long UnZigZag(unsigned long long v) {
+  return static_cast<long long>(v >> 1) ^ -static_cast<long long>(v & 1);
+}
+
+}  // namespace crest
+
+#endif  // BASE_VARINT_H__
@@ -8,17 +8,19 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
 // for details.
 
+#include <algorithm>
 #include <assert.h>
 #include <queue>
 #include <set>
 #include <stdio.h>
 #include <stdlib.h>
 #include <utility>
-#include <yices_c.h>
 
 #include "base/yices_solver.h"
 
 using std::make_pair;
+using std::sort;
+using std::unique;
 using std::queue;
 using std::set;
 
@@ -26,11 +28,148 @@ namespace crest {
 
 typedef vector<const SymbolicPred*>::const_iterator PredIt;
 
+namespace {
+
+// Builds the Yices term for the linear expression 'se'.
+yices_expr MakeSum(yices_context ctx, const SymbolicExpr& se,
+                   map<var_t,yices_expr>& x_expr) {
+  vector<yices_expr> terms;
+  terms.push_back(yices_mk_num(ctx, se.const_term()));
+  for (SymbolicExpr::TermIt j = se.terms().begin(); j != se.terms().end(); ++j) {
+    yices_expr prod[2] = { x_expr[j->first], yices_mk_num(ctx, j->second) };
+    terms.push_back(yices_mk_mul(ctx, prod, 2));
+  }
+  return yices_mk_sum(ctx, &terms.front(), terms.size());
+}
+
+// Builds the Yices term for "e op 0".
+yices_expr MakeCompare(yices_context ctx, compare_op_t op,
+                       yices_expr e, yices_expr zero) {
+  switch(op) {
+  case ops::EQ:  return yices_mk_eq(ctx, e, zero);
+  case ops::NEQ: return yices_mk_diseq(ctx, e, zero);
+  case ops::GT:  return yices_mk_gt(ctx, e, zero);
+  case ops::LE:  return yices_mk_le(ctx, e, zero);
+  case ops::LT:  return yices_mk_lt(ctx, e, zero);
+  case ops::GE:  return yices_mk_ge(ctx, e, zero);
+  default:
+    fprintf(stderr, "Unknown comparison operator: %d\n", op);
+    exit(1);
+  }
+}
+
+// Writes a query to the dump sink, in Yices syntax.
+void DumpAssert(FILE* f, const SymbolicPred& pred) {
+  string s;
+  pred.AppendToString(&s);
+  fprintf(f, "(assert %s)\n", s.c_str());
+}
+
+void DumpResult(FILE* f, bool sat, const map<var_t,value_t>& soln) {
+  fprintf(f, "(check) ; %s\n", sat ? "sat" : "unsat");
+  if (!sat)
+    return;
+  for (map<var_t,value_t>::const_iterator i = soln.begin(); i != soln.end(); ++i) {
+    fprintf(f, "; (= x%u %lld)\n", i->first, i->second);
+  }
+}
+
+}  // namespace
+
+// Solves a dependent slice of a path (see IncrementalSolve), answering
+// from the query cache when possible.
+bool YicesSolver::SolveCached(const map<var_t,type_t>& vars,
+                              const vector<const SymbolicPred*>& constraints,
+                              map<var_t,value_t>* soln) {
+  QueryCache* qc = cache();
+  if (!qc->enabled())
+    return Solve(vars, constraints, soln);
+
+  vector<unsigned> ids;
+  QueryCache::Key key;
+  qc->Canonicalize(vars, constraints, &ids, &key);
+  switch (qc->Lookup(key, soln)) {
+  case QueryCache::SAT:   return true;
+  case QueryCache::UNSAT: return false;
+  case QueryCache::MISS:  break;
+  }
+
+  vector<size_t> core_idx;
+  if (Solve(vars, constraints, soln, &core_idx)) {
+    qc->InsertSat(key, *soln);
+    return true;
+  }
+
+  QueryCache::Key core;
+  for (size_t i = 0; i < core_idx.size(); i++) {
+    core.push_back(ids[core_idx[i]]);
+  }
+  sort(core.begin(), core.end());
+  core.erase(unique(core.begin(), core.end()), core.end());
+  qc->InsertUnsat(key, core);
+  return false;
+}
+
+SolverStats* YicesSolver::stats() {
+  static SolverStats stats;
+  return &stats;
+}
+
+QueryCache* YicesSolver::cache() {
+  static QueryCache cache(1 << 16);
+  return &cache;
+}
+
 
 bool YicesSolver::IncrementalSolve(const vector<value_t>& old_soln,
 				   const map<var_t,type_t>& vars,
 				   const vector<const SymbolicPred*>& constraints,
 				   map<var_t,value_t>* soln) {
+  map<var_t,type_t> dependent_vars;
+  DependentVars(vars, constraints, &dependent_vars);
+
+  // Generate the list of dependent constraints.
+  vector<const SymbolicPred*> dependent_constraints;
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    if ((*i)->DependsOn(dependent_vars))
+      dependent_constraints.push_back(*i);
+  }
+
+  soln->clear();
+  if (SolveCached(dependent_vars, dependent_constraints, soln)) {
+    // Merge in the constrained variables.
+    set<var_t> tmp;
+    for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+      (*i)->AppendVars(&tmp);
+    }
+    for (set<var_t>::const_iterator i = tmp.begin(); i != tmp.end(); ++i) {
+      if (soln->find(*i) == soln->end()) {
+	soln->insert(make_pair(*i, old_soln[*i]));
+      }
+    }
+    return true;
+  }
+
+  return false;
+}
+
+
+bool YicesSolver::SolveSlice(const map<var_t,type_t>& vars,
+                             const vector<var_t>& slice_vars,
+                             const vector<const SymbolicPred*>& slice,
+                             map<var_t,value_t>* soln) {
+  map<var_t,type_t> dependent_vars;
+  for (size_t i = 0; i < slice_vars.size(); i++) {
+    dependent_vars.insert(*vars.find(slice_vars[i]));
+  }
+  soln->clear();
+  return SolveCached(dependent_vars, slice, soln);
+}
+
+
+void YicesSolver::DependentVars(const map<var_t,type_t>& vars,
+                                const vector<const SymbolicPred*>& constraints,
+                                map<var_t,type_t>* dependent_vars) {
   set<var_t> tmp;
   typedef set<var_t>::const_iterator VarIt;
 
@@ -48,12 +187,11 @@ bool YicesSolver::IncrementalSolve(const vector<value_t>& old_soln,
   // Initialize the set of dependent variables to those in the constraints.
   // (Assumption: Last element of constraints is the only new constraint.)
   // Also, initialize the queue for the BFS.
-  map<var_t,type_t> dependent_vars;
   queue<var_t> Q;
   tmp.clear();
   constraints.back()->AppendVars(&tmp);
   for (VarIt j = tmp.begin(); j != tmp.end(); ++j) {
-    dependent_vars.insert(*vars.find(*j));
+    dependent_vars->insert(*vars.find(*j));
     Q.push(*j);
   }
 
@@ -62,47 +200,30 @@ bool YicesSolver::IncrementalSolve(const vector<value_t>& old_soln,
     var_t i = Q.front();
     Q.pop();
     for (VarIt j = depends[i].begin(); j != depends[i].end(); ++j) {
-      if (dependent_vars.find(*j) == dependent_vars.end()) {
+      if (dependent_vars->find(*j) == dependent_vars->end()) {
 	Q.push(*j);
-	dependent_vars.insert(*vars.find(*j));
-      }
-    }
-  }
-
-  // Generate the list of dependent constraints.
-  vector<const SymbolicPred*> dependent_constraints;
-  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
-    if ((*i)->DependsOn(dependent_vars))
-      dependent_constraints.push_back(*i);
-  }
-
-  soln->clear();
-  if (Solve(dependent_vars, dependent_constraints, soln)) {
-    // Merge in the constrained variables.
-    for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
-      (*i)->AppendVars(&tmp);
-    }
-    for (set<var_t>::const_iterator i = tmp.begin(); i != tmp.end(); ++i) {
-      if (soln->find(*i) == soln->end()) {
-	soln->insert(make_pair(*i, old_soln[*i]));
+	dependent_vars->insert(*vars.find(*j));
       }
     }
-    return true;
   }
-
-  return false;
 }
 
 
 bool YicesSolver::Solve(const map<var_t,type_t>& vars,
 			const vector<const SymbolicPred*>& constraints,
-			map<var_t,value_t>* soln) {
+			map<var_t,value_t>* soln,
+			vector<size_t>* unsat_core) {
 
   typedef map<var_t,type_t>::const_iterator VarIt;
 
+  SolverStats* st = stats();
+  FILE* dump = st->dump_file();
+  double start = SolverStats::Now();
+
   // yices_enable_log_file("yices_log");
   yices_context ctx = yices_mk_context();
   assert(ctx);
+  if (dump) fprintf(dump, "(reset)\n");
 
   // Type limits.
   vector<yices_expr> min_expr(types::LONG_LONG+1);
@@ -141,42 +262,23 @@ bool YicesSolver::Solve(const map<var_t,type_t>& vars,
   yices_expr zero = yices_mk_num(ctx, 0);
   assert(zero);
 
-  { // Constraints.
-    vector<yices_expr> terms;
-    for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
-      const SymbolicExpr& se = (*i)->expr();
-      terms.clear();
-      terms.push_back(yices_mk_num(ctx, se.const_term()));
-      for (SymbolicExpr::TermIt j = se.terms().begin(); j != se.terms().end(); ++j) {
-	yices_expr prod[2] = { x_expr[j->first], yices_mk_num(ctx, j->second) };
-	terms.push_back(yices_mk_mul(ctx, prod, 2));
-      }
-      yices_expr e = yices_mk_sum(ctx, &terms.front(), terms.size());
-
-			printf("\nExpr: ");
-			yices_pp_expr(e);
-			printf("\nContext: ");
-			yices_dump_context(ctx);
-			printf("\n");
-
-      yices_expr pred;
-      switch((*i)->op()) {
-      case ops::EQ:  pred = yices_mk_eq(ctx, e, zero); break;
-      case ops::NEQ: pred = yices_mk_diseq(ctx, e, zero); break;
-      case ops::GT:  pred = yices_mk_gt(ctx, e, zero); break;
-      case ops::LE:  pred = yices_mk_le(ctx, e, zero); break;
-      case ops::LT:  pred = yices_mk_lt(ctx, e, zero); break;
-      case ops::GE:  pred = yices_mk_ge(ctx, e, zero); break;
-      default:
-	fprintf(stderr, "Unknown comparison operator: %d\n", (*i)->op());
-	exit(1);
-      }
-      yices_assert(ctx, pred);
+  // Constraints.  (They are retractable when a core is wanted, since
+  // Yices only reports cores in terms of retractable assertions.)
+  vector<assertion_id> assertion_ids;
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    yices_expr e = MakeSum(ctx, (*i)->expr(), x_expr);
+    yices_expr c = MakeCompare(ctx, (*i)->op(), e, zero);
+    if (unsat_core) {
+      assertion_ids.push_back(yices_assert_retractable(ctx, c));
+    } else {
+      yices_assert(ctx, c);
     }
+    if (dump) DumpAssert(dump, **i);
   }
 
-	printf("\nModel: ");
+  double built = SolverStats::Now();
   bool success = (yices_check(ctx) == l_true);
+  double checked = SolverStats::Now();
   if (success) {
     soln->clear();
     yices_model model = yices_get_model(ctx);
@@ -184,17 +286,151 @@ bool YicesSolver::Solve(const map<var_t,type_t>& vars,
       long val;
       assert(yices_get_int_value(model, x_decl[i->first], &val));
       soln->insert(make_pair(i->first, val));
-			printf("%x (%x) = %d\n", i->first, i->second, val);
+    }
+  } else if (unsat_core) {
+    // Map the core back to constraint indices.  If Yices gives no core,
+    // fall back on all of the constraints.
+    unsat_core->clear();
+    vector<assertion_id> core(yices_get_unsat_core_size(ctx));
+    if (!core.empty())
+      core.resize(yices_get_unsat_core(ctx, &core.front()));
+    map<assertion_id,size_t> index;
+    for (size_t i = 0; i < assertion_ids.size(); i++) {
+      index[assertion_ids[i]] = i;
+    }
+    for (size_t i = 0; i < core.size(); i++) {
+      map<assertion_id,size_t>::const_iterator it = index.find(core[i]);
+      if (it != index.end())
+        unsat_core->push_back(it->second);
+    }
+    if (unsat_core->empty()) {
+      for (size_t i = 0; i < constraints.size(); i++) {
+        unsat_core->push_back(i);
+      }
     }
   }
-	else {
-		printf("UNSAT\n");
-	}
+  if (dump) DumpResult(dump, success, *soln);
+  st->AddQuery(vars.size(), constraints.size(), built - start, checked - built, success);
 
   yices_del_context(ctx);
   return success;
 }
 
 
+YicesSession::YicesSession()
+  : ctx_(yices_mk_context()), num_asserted_(0),
+    min_expr_(types::LONG_LONG+1), max_expr_(types::LONG_LONG+1) {
+  assert(ctx_);
+
+  // Type limits.
+  for (int i = types::U_CHAR; i <= types::LONG_LONG; i++) {
+    min_expr_[i] = yices_mk_num_from_string(ctx_, const_cast<char*>(kMinValueStr[i]));
+    max_expr_[i] = yices_mk_num_from_string(ctx_, const_cast<char*>(kMaxValueStr[i]));
+    assert(min_expr_[i]);
+    assert(max_expr_[i]);
+  }
+
+  char int_ty_name[] = "int";
+  int_ty_ = yices_mk_type(ctx_, int_ty_name);
+  assert(int_ty_);
+  zero_ = yices_mk_num(ctx_, 0);
+  assert(zero_);
+
+  scope_vars_.resize(1);
+  scope_asserted_.push_back(0);
+}
+
+YicesSession::~YicesSession() {
+  yices_del_context(ctx_);
+}
+
+void YicesSession::Push() {
+  yices_push(ctx_);
+  scope_vars_.push_back(vector<var_t>());
+  scope_asserted_.push_back(num_asserted_);
+  FILE* dump = YicesSolver::stats()->dump_file();
+  if (dump) fprintf(dump, "(push)\n");
+}
+
+void YicesSession::Pop() {
+  assert(scope_vars_.size() > 1);
+  const vector<var_t>& unbound = scope_vars_.back();
+  for (size_t i = 0; i < unbound.size(); i++) {
+    bounded_.erase(unbound[i]);
+  }
+  scope_vars_.pop_back();
+  num_asserted_ = scope_asserted_.back();
+  scope_asserted_.pop_back();
+  yices_pop(ctx_);
+  FILE* dump = YicesSolver::stats()->dump_file();
+  if (dump) fprintf(dump, "(pop)\n");
+}
+
+void YicesSession::Assert(const map<var_t,type_t>& vars, const SymbolicPred& pred) {
+  yices_assert(ctx_, MakePred(vars, pred));
+  num_asserted_++;
+  FILE* dump = YicesSolver::stats()->dump_file();
+  if (dump) DumpAssert(dump, pred);
+}
+
+bool YicesSession::Check(const map<var_t,type_t>& vars, const SymbolicPred& pred,
+                         const map<var_t,type_t>& soln_vars,
+                         map<var_t,value_t>* soln) {
+  double start = SolverStats::Now();
+  Push();
+  Assert(vars, pred);
+
+  double built = SolverStats::Now();
+  bool success = (yices_check(ctx_) == l_true);
+  double checked = SolverStats::Now();
+  if (success) {
+    soln->clear();
+    yices_model model = yices_get_model(ctx_);
+    typedef map<var_t,type_t>::const_iterator VarIt;
+    for (VarIt i = soln_vars.begin(); i != soln_vars.end(); ++i) {
+      map<var_t,yices_var_decl>::const_iterator d = x_decl_.find(i->first);
+      if (d == x_decl_.end())
+        continue;
+      long val;
+      assert(yices_get_int_value(model, d->second, &val));
+      soln->insert(make_pair(i->first, val));
+    }
+  }
+
+  SolverStats* st = YicesSolver::stats();
+  if (st->dump_file()) DumpResult(st->dump_file(), success, *soln);
+  st->AddQuery(bounded_.size(), num_asserted_, built - start, checked - built, success);
+  Pop();
+  return success;
+}
+
+yices_expr YicesSession::MakePred(const map<var_t,type_t>& vars,
+                                  const SymbolicPred& pred) {
+  // Declare the variables of 'pred' (once), and make sure their type
+  // bounds are asserted.
+  const SymbolicExpr::TermIt end = pred.expr().terms().end();
+  for (SymbolicExpr::TermIt j = pred.expr().terms().begin(); j != end; ++j) {
+    var_t v = j->first;
+    if (x_decl_.find(v) == x_decl_.end()) {
+      char buff[32];
+      snprintf(buff, sizeof(buff), "x%d", v);
+      x_decl_[v] = yices_mk_var_decl(ctx_, buff, int_ty_);
+      x_expr_[v] = yices_mk_var_from_decl(ctx_, x_decl_[v]);
+      assert(x_decl_[v]);
+      assert(x_expr_[v]);
+    }
+    if (bounded_.find(v) == bounded_.end()) {
+      type_t ty = vars.find(v)->second;
+      yices_assert(ctx_, yices_mk_ge(ctx_, x_expr_[v], min_expr_[ty]));
+      yices_assert(ctx_, yices_mk_le(ctx_, x_expr_[v], max_expr_[ty]));
+      bounded_.insert(v);
+      scope_vars_.back().push_back(v);
+    }
+  }
+
+  yices_expr e = MakeSum(ctx_, pred.expr(), x_expr_);
+  return MakeCompare(ctx_, pred.op(), e, zero_);
+}
+
 }  // namespace crest
 
@@ -11,13 +11,19 @@
 #ifndef BASE_YICES_SOLVER_H__
 #define BASE_YICES_SOLVER_H__
 
+#include <stddef.h>
 #include <map>
+#include <set>
 #include <vector>
+#include <yices_c.h>
 
 #include "base/basic_types.h"
+#include "base/query_cache.h"
+#include "base/solver_stats.h"
 #include "base/symbolic_predicate.h"
 
 using std::map;
+using std::set;
 using std::vector;
 
 namespace crest {
@@ -29,12 +35,86 @@ class YicesSolver {
                                const vector<const SymbolicPred*>& constraints,
 			       map<var_t,value_t>* soln);
 
+  // Solves 'slice', the constraints a negated constraint depends on, over
+  // their variables 'slice_vars' (see SymbolicPath::DependentSlice).
+  // Fills 'soln' with values for just those variables; the rest may keep
+  // their old values.
+  static bool SolveSlice(const map<var_t,type_t>& vars,
+                         const vector<var_t>& slice_vars,
+                         const vector<const SymbolicPred*>& slice,
+                         map<var_t,value_t>* soln);
+
+  // If the constraints are unsatisfiable and 'unsat_core' is not NULL,
+  // fills it with the indices of an unsatisfiable subset of them.
   static bool Solve(const map<var_t,type_t>& vars,
                     const vector<const SymbolicPred*>& constraints,
-		    map<var_t,value_t>* soln);
+		    map<var_t,value_t>* soln,
+		    vector<size_t>* unsat_core = NULL);
 
   static bool ReadSolutionFromFileOrDie(const string& file,
                                         map<var_t,value_t>* soln);
+
+  // Computes the variables that the last constraint depends on,
+  // directly or through other constraints.
+  static void DependentVars(const map<var_t,type_t>& vars,
+                            const vector<const SymbolicPred*>& constraints,
+                            map<var_t,type_t>* dependent_vars);
+
+  // Statistics for all queries, by both the solver and any session.
+  static SolverStats* stats();
+
+  // The cache consulted by IncrementalSolve.
+  static QueryCache* cache();
+
+ private:
+  static bool SolveCached(const map<var_t,type_t>& vars,
+                          const vector<const SymbolicPred*>& constraints,
+                          map<var_t,value_t>* soln);
+};
+
+// A Yices context that is kept across queries, for searches (such as
+// depth-first search) that extend and negate a shared path prefix.  The
+// prefix stays asserted, so each query asserts only its new constraint.
+//
+// Assertions are grouped in scopes: Pop() retracts every assertion made
+// since the matching Push().
+class YicesSession {
+ public:
+  YicesSession();
+  ~YicesSession();
+
+  void Push();
+  void Pop();
+
+  // Asserts 'pred' in the current scope.
+  void Assert(const map<var_t,type_t>& vars, const SymbolicPred& pred);
+
+  // Checks whether the asserted constraints and 'pred' are satisfiable,
+  // without keeping 'pred'.  If so, fills in 'soln' with the values of
+  // the variables in 'soln_vars'.
+  bool Check(const map<var_t,type_t>& vars, const SymbolicPred& pred,
+             const map<var_t,type_t>& soln_vars, map<var_t,value_t>* soln);
+
+ private:
+  yices_context ctx_;
+  size_t num_asserted_;
+  yices_type int_ty_;
+  yices_expr zero_;
+  vector<yices_expr> min_expr_;
+  vector<yices_expr> max_expr_;
+
+  map<var_t,yices_var_decl> x_decl_;
+  map<var_t,yices_expr> x_expr_;
+
+  // Declarations outlive scopes, but the type bounds asserted for a
+  // variable do not.  These are the variables whose bounds are currently
+  // asserted, grouped by the scope they were asserted in.
+  set<var_t> bounded_;
+  vector< vector<var_t> > scope_vars_;
+  // The number of constraints asserted before each open scope.
+  vector<size_t> scope_asserted_;
+
+  yices_expr MakePred(const map<var_t,type_t>& vars, const SymbolicPred& pred);
 };
 
 }  // namespace crest
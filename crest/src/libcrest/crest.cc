@@ -9,20 +9,49 @@
 // for details.
 
 #include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 #include <unistd.h>
-#include <fstream>
+#include <deque>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "base/byte_reader.h"
+#include "base/coverage_map.h"
+#include "base/fork_server.h"
+#include "base/receive_schedule.h"
 #include "base/symbolic_interpreter.h"
+#include "base/transport.h"
+#include "base/varint.h"
 #include "libcrest/crest.h"
 
+using std::deque;
+using std::make_pair;
+using std::map;
+using std::pair;
+using std::string;
 using std::vector;
 using namespace crest;
 
 // The symbolic interpreter. */
 static SymbolicInterpreter* SI;
 
+// How we get our input and send back the execution (see base/transport.h).
+static TransportClient* transport_client;
+
+// Where we mark each branch we cover, for run_crest (NULL if it gave us
+// no coverage map).
+static CoverageMap* coverage_map;
+
+// Are we a child forked by the fork server?  (See base/fork_server.h.)
+static int fork_server_child;
+
 // Have we read an input yet?  Until we have, generate only the
 // minimal instrumentation necessary to track which branches were
 // reached by the execution path.
@@ -48,14 +77,14 @@ static void __CrestAtExit();
 void __CrestInit() {
   /* read the input */
   vector<value_t> input;
-  std::ifstream in("input");
-  value_t val;
-  while (in >> val) {
-    input.push_back(val);
+  transport_client = TransportClient::FromEnvironment();
+  // A fork server gets its inputs later, one for each forked child.
+  if (!getenv(crest::fork_server::kEnvVar)) {
+    transport_client->ReadInput(&input);
   }
-  in.close();
 
   SI = new SymbolicInterpreter(input);
+  coverage_map = CoverageMap::FromEnvironment();
 
   pre_symbolic = 1;
 
@@ -63,16 +92,15 @@ void __CrestInit() {
 }
 
 void __CrestAtExit() {
+  SI->FlushTrace();
+
   const SymbolicExecution& ex = SI->execution();
 
-  /* Write the execution out to file 'szd_execution'. */
+  /* Send the execution back to run_crest. */
   string buff;
-  buff.reserve(1 << 26);
+  buff.reserve(1 << 20);
   ex.Serialize(&buff);
-  std::ofstream out("szd_execution", std::ios::out | std::ios::binary);
-  out.write(buff.data(), buff.size());
-  assert(!out.fail());
-  out.close();
+  transport_client->WriteExecution(buff);
 }
 
 //
@@ -110,6 +138,8 @@ void __CrestApply2(__CREST_ID id, __CREST_OP op, __CREST_VALUE val) {
 }
 
 void __CrestBranch(__CREST_ID id, __CREST_BRANCH_ID bid, __CREST_BOOL b) {
+  if (coverage_map) coverage_map->Cover(bid);
+
   if (pre_symbolic) {
     // Precede the branch with a fake (concrete) load.
     SI->Load(id, 0, b);
@@ -268,52 +298,527 @@ void __CrestLogPCOnGdbQuery(unsigned int x) { SI->ApplyLogPC_gdb(x); }
 
 void __CrestLogSpec(char* op, int* op1, int* op2) { SI->ApplyLogSpec(op, op1, op2); }
 
+// Fork server.  Parks this rank right after MPI_Init and, for each RUN
+// command from run_crest, forks a child to run the rest of the program.
+// Each child returns from __CR_MPI_Init with the MPI state of its parent,
+// which never uses MPI again.
+static void __CrestForkServer() {
+  using namespace crest::fork_server;
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int cmd_fd = open(CommandFifo(rank).c_str(), O_RDONLY);
+  int reply_fd = open(ReplyFifo(rank).c_str(), O_WRONLY);
+  if ((cmd_fd < 0) || (reply_fd < 0) || !WriteAll(reply_fd, &rank, sizeof(rank))) {
+    perror("Failed to open fork server FIFOs");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  vector<value_t> input;
+  while (ReadCommand(cmd_fd, &input)) {
+    fflush(NULL);
+    pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+      close(cmd_fd);
+      close(reply_fd);
+      fork_server_child = 1;
+      SI->ResetInputs(input);
+      return;
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    if (!WriteAll(reply_fd, &status, sizeof(status)))
+      break;
+  }
+
+  // Shut down without running __CrestAtExit, which would overwrite the
+  // execution written by the last child.
+  MPI_Finalize();
+  fflush(NULL);
+  _exit(0);
+}
+
+// Symbolic messages.  With each point-to-point message in
+// MPI_COMM_WORLD, the sender also sends the symbolic values of its
+// buffer (see SymbolicInterpreter::SerializeMessage), with the same tag
+// but on a private duplicate of MPI_COMM_WORLD, so they never match the
+// program's own receives.  Messages between a pair of ranks with the
+// same tag are received in the order sent.
+//
+// Each value message starts with its sequence number: the ordinal of
+// its data message among the sender's messages to that rank with that
+// tag.  The receiver counts the data messages it receives the same way,
+// and binds only the values with exactly its count (and with a
+// fingerprint of the data that matches what it received).  A message
+// from a plain MPI_Send (one that is not instrumented) has no values; it
+// is taken as concrete, and values with a number the receiver has
+// already passed are dropped, never bound to another message.  (A plain
+// send does not advance the sender's count, so the values of a later
+// instrumented send to the same rank and tag carry a number the
+// receiver has already used.  The fingerprint keeps them off the plain
+// message, and they are dropped.  That only loses symbolic values.)
+//
+// The values are sent without blocking, so a receive that never
+// collects them (one that is not instrumented) cannot hang the sender.
+// They are sent before the data, so they have nearly always arrived by
+// the time the data has.  A receive waits for them at most
+// kSymbolicRecvTimeout seconds, and not at all once a later value
+// message from that rank and tag has arrived (which proves its own were
+// never sent).
+static MPI_Comm symbolic_comm = MPI_COMM_NULL;
+
+static const double kSymbolicRecvTimeout = 0.01;
+
+static double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+// Value messages still in flight, with their buffers.
+static vector<pair<MPI_Request,string*> > pending_sends;
+
+static void ReapPendingSends(bool wait) {
+  size_t j = 0;
+  for (size_t i = 0; i < pending_sends.size(); i++) {
+    int done = 0;
+    if (wait) {
+      MPI_Wait(&pending_sends[i].first, MPI_STATUS_IGNORE);
+      done = 1;
+    } else {
+      MPI_Test(&pending_sends[i].first, &done, MPI_STATUS_IGNORE);
+    }
+    if (done) {
+      delete pending_sends[i].second;
+    } else {
+      pending_sends[j++] = pending_sends[i];
+    }
+  }
+  pending_sends.resize(j);
+}
+
+// Our Lamport clock (see base/receive_schedule.h), sent in every value
+// message after its sequence number and data fingerprint.
+static int lamport_clock;
+
+static fingerprint_t DataFingerprint(const void* buf, size_t len) {
+  const char* p = static_cast<const char*>(buf);
+  fingerprint_t h = MixFingerprint(0, len);
+  for (; len >= sizeof(unsigned long long); len -= sizeof(unsigned long long)) {
+    unsigned long long w;
+    memcpy(&w, p, sizeof(w));
+    h = MixFingerprint(h, w);
+    p += sizeof(w);
+  }
+  for (; len > 0; len--)
+    h = MixFingerprint(h, static_cast<unsigned char>(*p++));
+  return h;
+}
+
+// The number of data messages sent to, and received from, each (rank,
+// tag).
+typedef map<pair<int,int>, unsigned long long> MessageCounts;
+static MessageCounts messages_sent;
+static MessageCounts messages_received;
+
+// Value messages received before their data message, by (source, tag),
+// each with its sequence number.  (Since value messages are received in
+// the order sent, each queue is in sequence order.)
+typedef deque<pair<unsigned long long,string> > ValueQueue;
+static map<pair<int,int>, ValueQueue> early_values;
+
+static void SendSymbolic(const void* buf, int count, MPI_Datatype datatype, int dest, int tag) {
+  int size;
+  MPI_Type_size(datatype, &size);
+  string* s = new string();
+  AppendVarint(s, messages_sent[make_pair(dest, tag)]++);
+  AppendVarint(s, DataFingerprint(buf, static_cast<size_t>(count) * size));
+  AppendVarint(s, lamport_clock);
+  SI->SerializeMessage((addr_t)buf, count, size, s);
+
+  MPI_Request req;
+  MPI_Isend(const_cast<char*>(s->data()), s->size(), MPI_BYTE, dest, tag, symbolic_comm, &req);
+  pending_sends.push_back(make_pair(req, s));
+  ReapPendingSends(false);
+}
+
+// Returns the sender's clock (0 if the message had no values).
+static int RecvSymbolic(void* buf, int count, MPI_Datatype datatype, int source, int tag) {
+  int size;
+  MPI_Type_size(datatype, &size);
+
+  pair<int,int> key = make_pair(source, tag);
+  unsigned long long seq = messages_received[key]++;
+  ValueQueue& queue = early_values[key];
+
+  double deadline = Now() + kSymbolicRecvTimeout;
+  for (;;) {
+    // Drop the values of messages already received.
+    while (!queue.empty() && (queue.front().first < seq))
+      queue.pop_front();
+    if (!queue.empty())
+      break;
+
+    MPI_Status status;
+    int found = 0;
+    MPI_Iprobe(source, tag, symbolic_comm, &found, &status);
+    if (found) {
+      int len;
+      MPI_Get_count(&status, MPI_BYTE, &len);
+      vector<char> data(len + 1);
+      MPI_Recv(&data.front(), len, MPI_BYTE, source, tag, symbolic_comm, MPI_STATUS_IGNORE);
+      ByteReader r(&data.front(), len);
+      unsigned long long n;
+      if (r.ReadVarint(&n)) {
+        queue.push_back(make_pair(n, string(&data.front() + (len - r.remaining()), r.remaining())));
+      }
+      continue;
+    }
+
+    if (Now() >= deadline)
+      break;
+    usleep(100);
+  }
+
+  string data;
+  fingerprint_t fp = 0;
+  if (!queue.empty() && (queue.front().first == seq)) {
+    data.swap(queue.front().second);
+    queue.pop_front();
+  }
+  ByteReader r(data.data(), data.size());
+  if (data.empty() || !r.ReadVarint(&fp)
+      || (fp != DataFingerprint(buf, static_cast<size_t>(count) * size))) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    fprintf(stderr, "Rank %d: no symbolic values for the message from rank %d (tag %d); taking it as concrete.\n",
+            rank, source, tag);
+    SI->MakeConcrete((addr_t)buf, count, size);
+    return 0;
+  }
+
+  unsigned long long send_clock = 0;
+  r.ReadVarint(&send_clock);
+  const char* values = data.data() + (data.size() - r.remaining());
+
+  if (SI->BindMessage((addr_t)buf, count, size, values, r.remaining())) {
+    // A symbolic value arrived, so from now on, we must track the
+    // operations on it.
+    pre_symbolic = 0;
+  }
+  return static_cast<int>(send_clock);
+}
+
+// Wildcard receives.  run_crest may force the match of each wildcard
+// receive in MPI_COMM_WORLD (see base/receive_schedule.h), to explore
+// the other sends it could have matched.  A forced receive waits for a
+// message from its source, but only for kForcedMatchTimeout seconds: the
+// new run may never make that send, and then the receive stays a
+// wildcard rather than hang the run.
+static const double kForcedMatchTimeout = 5.0;
+
+// The forced sources, read at our first wildcard receive (after any fork
+// by the fork server), and the number of wildcard receives so far.
+static bool schedule_read;
+static vector<int> forced_sources;
+static unsigned num_wildcard_recvs;
+
+// The source to post wildcard receive number 'index' of 'rank' with.
+static int ForcedSource(int rank, unsigned index, int tag, MPI_Comm comm) {
+  if (!schedule_read) {
+    ReadSchedule(rank, &forced_sources);
+    schedule_read = true;
+  }
+  if ((index >= forced_sources.size()) || (forced_sources[index] < 0))
+    return MPI_ANY_SOURCE;
+
+  int source = forced_sources[index];
+  double deadline = Now() + kForcedMatchTimeout;
+  do {
+    int found = 0;
+    MPI_Iprobe(source, tag, comm, &found, MPI_STATUS_IGNORE);
+    if (found) return source;
+    usleep(100);
+  } while (Now() < deadline);
+  fprintf(stderr, "Rank %d: no message from rank %d for forced receive %u.\n", rank, source, index);
+  return MPI_ANY_SOURCE;
+}
+
+// Symbolic collectives.  A collective on MPI_COMM_WORLD is followed by
+// collectives on symbolic_comm moving the symbolic values of the buffers
+// (see SymbolicInterpreter::SerializeMessage) the same way: a broadcast
+// copies the root's values, a scatter or gather moves slices, and an
+// MPI_SUM reduction of integers sums them.  Every rank makes the same
+// collectives in the same order, so they match up.
+
+static bool TracksCollective(MPI_Comm comm) {
+  return (comm == MPI_COMM_WORLD) && (symbolic_comm != MPI_COMM_NULL);
+}
+
+// Gives the 'count' elements at 'buf' the values in 's'.
+static void Bind(void* buf, int count, int size, const string& s) {
+  if (SI->BindMessage((addr_t)buf, count, size, s.data(), s.size())) pre_symbolic = 0;
+}
+
+static bool IsInteger(MPI_Datatype t) {
+  return ((t == MPI_CHAR) || (t == MPI_SIGNED_CHAR) || (t == MPI_UNSIGNED_CHAR) || (t == MPI_SHORT)
+          || (t == MPI_UNSIGNED_SHORT) || (t == MPI_INT) || (t == MPI_UNSIGNED) || (t == MPI_LONG)
+          || (t == MPI_UNSIGNED_LONG) || (t == MPI_LONG_LONG));
+}
+
+// Element 'i' of 'buf', an array of integer type 't'.
+static long long ReadInteger(const void* buf, int i, MPI_Datatype t) {
+  if ((t == MPI_CHAR) || (t == MPI_SIGNED_CHAR)) return ((const signed char*)buf)[i];
+  if (t == MPI_UNSIGNED_CHAR) return ((const unsigned char*)buf)[i];
+  if (t == MPI_SHORT) return ((const short*)buf)[i];
+  if (t == MPI_UNSIGNED_SHORT) return ((const unsigned short*)buf)[i];
+  if (t == MPI_INT) return ((const int*)buf)[i];
+  if (t == MPI_UNSIGNED) return ((const unsigned int*)buf)[i];
+  if (t == MPI_LONG) return ((const long*)buf)[i];
+  if (t == MPI_UNSIGNED_LONG) return ((const unsigned long*)buf)[i];
+  return ((const long long*)buf)[i];
+}
+
+static void BcastSymbolic(string* s, int root) {
+  int len = s->size();
+  MPI_Bcast(&len, 1, MPI_INT, root, symbolic_comm);
+  vector<char> data(len + 1);
+  if (!s->empty()) memcpy(&data.front(), s->data(), len);
+  MPI_Bcast(&data.front(), len, MPI_BYTE, root, symbolic_comm);
+  s->assign(&data.front(), len);
+}
+
+// Collects each rank's 'mine' into (*all)[rank] at the root.
+static void GatherSymbolic(const string& mine, int root, vector<string>* all) {
+  int rank, num_ranks;
+  MPI_Comm_rank(symbolic_comm, &rank);
+  MPI_Comm_size(symbolic_comm, &num_ranks);
+
+  int len = mine.size();
+  vector<int> lens(num_ranks), offsets(num_ranks + 1, 0);
+  MPI_Gather(&len, 1, MPI_INT, &lens.front(), 1, MPI_INT, root, symbolic_comm);
+  for (int r = 0; r < num_ranks; r++) offsets[r + 1] = offsets[r] + lens[r];
+
+  vector<char> data(offsets[num_ranks] + 1);
+  MPI_Gatherv(const_cast<char*>(mine.data()), len, MPI_BYTE, &data.front(), &lens.front(), &offsets.front(),
+              MPI_BYTE, root, symbolic_comm);
+  if (rank != root) return;
+  all->resize(num_ranks);
+  for (int r = 0; r < num_ranks; r++) (*all)[r].assign(&data[offsets[r]], lens[r]);
+}
+
+// Sends slices[rank] (given at the root) to each rank, in 'mine'.
+static void ScatterSymbolic(const vector<string>& slices, int root, string* mine) {
+  int rank, num_ranks;
+  MPI_Comm_rank(symbolic_comm, &rank);
+  MPI_Comm_size(symbolic_comm, &num_ranks);
+
+  vector<int> lens(num_ranks), offsets(num_ranks + 1, 0);
+  string data;
+  if (rank == root) {
+    for (int r = 0; r < num_ranks; r++) {
+      lens[r] = slices[r].size();
+      offsets[r + 1] = offsets[r] + lens[r];
+      data += slices[r];
+    }
+  }
+  int len;
+  MPI_Scatter(&lens.front(), 1, MPI_INT, &len, 1, MPI_INT, root, symbolic_comm);
+  vector<char> buf(len + 1);
+  MPI_Scatterv(const_cast<char*>(data.data()), &lens.front(), &offsets.front(), MPI_BYTE, &buf.front(), len,
+               MPI_BYTE, root, symbolic_comm);
+  mine->assign(&buf.front(), len);
+}
+
 // MPI wrapper function definitions
 
-int __CR_MPI_Init(int* argc, char*** argv) { MPI_Init(argc, argv); }
-int __CR_MPI_Finalize(void) { MPI_Finalize(); }
-int __CR_MPI_Comm_size(MPI_Comm comm, int* size) { MPI_Comm_size(comm, size); }
+int __CR_MPI_Init(int* argc, char*** argv) {
+  int ret = MPI_Init(argc, argv);
+  // (Before any fork server starts, so that its children share it.)
+  MPI_Comm_dup(MPI_COMM_WORLD, &symbolic_comm);
+  if (getenv(crest::fork_server::kEnvVar)) {
+    __CrestForkServer();
+  }
+  return ret;
+}
+
+int __CR_MPI_Finalize(void) {
+  ReapPendingSends(true);
+  // A forked child leaves MPI to its parent.
+  if (fork_server_child) return MPI_SUCCESS;
+  return MPI_Finalize();
+}
+int __CR_MPI_Comm_size(MPI_Comm comm, int* size) { return MPI_Comm_size(comm, size); }
 
-int __CR_MPI_Comm_rank(MPI_Comm comm, int* rank) { MPI_Comm_rank(comm, rank); }
+int __CR_MPI_Comm_rank(MPI_Comm comm, int* rank) { return MPI_Comm_rank(comm, rank); }
 
 int __CR_MPI_Send(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm) {
   // log MPI_Send call
 
   int rank = 0;
-  MPI_Send(buf, count, datatype, dest, tag, comm);
+  if ((comm == MPI_COMM_WORLD) && (symbolic_comm != MPI_COMM_NULL)) {
+    SendSymbolic(buf, count, datatype, dest, tag);
+  }
+  int ret = MPI_Send(buf, count, datatype, dest, tag, comm);
   MPI_Comm_rank(comm, &rank);
   SI->ApplyMPICommLog(MPI_SEND, rank, dest);
+  return ret;
 }
 
 int __CR_MPI_Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status* status) {
 
-  MPI_Recv(buf, count, datatype, source, tag, comm, status);
-
   int rank;
   MPI_Comm_rank(comm, &rank);
+  bool tracked = (comm == MPI_COMM_WORLD) && (symbolic_comm != MPI_COMM_NULL);
+
+  RecvEvent e;
+  e.rank = rank;
+  e.wildcard = (source == MPI_ANY_SOURCE);
+  e.any_tag = (tag == MPI_ANY_TAG);
+  int posted = source;
+  if (tracked && e.wildcard) {
+    posted = ForcedSource(rank, num_wildcard_recvs++, tag, comm);
+    lamport_clock++;
+  }
+
+  MPI_Status local_status;
+  if (status == MPI_STATUS_IGNORE) status = &local_status;
+  int ret = MPI_Recv(buf, count, datatype, posted, tag, comm, status);
+  if ((ret == MPI_SUCCESS) && tracked && (status->MPI_SOURCE != MPI_PROC_NULL)) {
+    // Only the elements actually received were overwritten.
+    int received;
+    MPI_Get_count(status, datatype, &received);
+    if ((received == MPI_UNDEFINED) || (received > count)) received = count;
+    // (From the rank and tag actually matched, in case of wildcards.)
+    e.send_clock = RecvSymbolic(buf, received, datatype, status->MPI_SOURCE, status->MPI_TAG);
+    e.clock = lamport_clock;
+    if (e.send_clock > lamport_clock) lamport_clock = e.send_clock;
+    e.source = status->MPI_SOURCE;
+    e.tag = status->MPI_TAG;
+    SI->RecordReceive(e);
+  }
+
   SI->ApplyMPICommLog(MPI_RECV, source, rank);
+  return ret;
 }
 
 int __CR_MPI_Bcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
   SI->ApplyMPILog("MPI_Bcast");
-  MPI_Bcast(buffer, count, datatype, root, comm);
+  int ret = MPI_Bcast(buffer, count, datatype, root, comm);
+  if ((ret != MPI_SUCCESS) || !TracksCollective(comm)) return ret;
+
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Type_size(datatype, &size);
+  string s;
+  if (rank == root) SI->SerializeMessage((addr_t)buffer, count, size, &s);
+  BcastSymbolic(&s, root);
+  if (rank != root) Bind(buffer, count, size, s);
+  return ret;
 }
 
 int __CR_MPI_Reduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root,
                     MPI_Comm comm) {
-  MPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Type_size(datatype, &size);
+  bool tracked = TracksCollective(comm);
+  // Only sums of integers are linear in the inputs; the result of any
+  // other reduction is concrete.
+  bool sum = tracked && (op == MPI_SUM) && IsInteger(datatype) && (count > 0);
+
+  // (Our contribution, before the reduction can overwrite it.)
+  string mine;
+  vector<long long> concrete;
+  if (sum) {
+    const void* in = (sendbuf == MPI_IN_PLACE) ? recvbuf : sendbuf;
+    SI->SerializeMessage((addr_t)in, count, size, &mine);
+    concrete.resize(count, 0);
+    for (int i = 0; i < count; i++) {
+      if (!SI->IsSymbolic((addr_t)in + i * size)) concrete[i] = ReadInteger(in, i, datatype);
+    }
+  }
+
+  int ret = MPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+  if ((ret != MPI_SUCCESS) || !tracked) return ret;
+
+  if (sum) {
+    vector<string> all;
+    GatherSymbolic(mine, root, &all);
+    vector<long long> concrete_sum(count);
+    MPI_Reduce(&concrete.front(), &concrete_sum.front(), count, MPI_LONG_LONG, MPI_SUM, root, symbolic_comm);
+    if ((rank == root)
+        && SI->BindSum((addr_t)recvbuf, count, size, all,
+                       vector<value_t>(concrete_sum.begin(), concrete_sum.end()))) {
+      pre_symbolic = 0;
+    }
+  } else if (rank == root) {
+    SI->MakeConcrete((addr_t)recvbuf, count, size);
+  }
+  return ret;
 }
 
-int __CR_MPI_Barrier(MPI_Comm comm) { MPI_Barrier(comm); }
+int __CR_MPI_Barrier(MPI_Comm comm) { return MPI_Barrier(comm); }
 
 int __CR_MPI_Scatter(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
                      MPI_Datatype recvtype, int root, MPI_Comm comm) {
 
-  MPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  int ret = MPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  if ((ret != MPI_SUCCESS) || !TracksCollective(comm)) return ret;
+
+  int rank, num_ranks, recv_size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &num_ranks);
+  MPI_Type_size(recvtype, &recv_size);
+
+  // The root slices its buffer, one slice of 'sendcount' per rank.
+  vector<string> slices;
+  if (rank == root) {
+    int send_size;
+    MPI_Type_size(sendtype, &send_size);
+    slices.resize(num_ranks);
+    for (int r = 0; r < num_ranks; r++) {
+      SI->SerializeMessage((addr_t)sendbuf + r * sendcount * send_size, sendcount, send_size, &slices[r]);
+    }
+  }
+  string mine;
+  ScatterSymbolic(slices, root, &mine);
+  // (The root's slice stays in place if it scattered MPI_IN_PLACE.)
+  if ((rank != root) || (recvbuf != MPI_IN_PLACE)) Bind(recvbuf, recvcount, recv_size, mine);
+  return ret;
 }
 
 int __CR_MPI_Gather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
                     MPI_Datatype recvtype, int root, MPI_Comm comm) {
 
-  MPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  int ret = MPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  if ((ret != MPI_SUCCESS) || !TracksCollective(comm)) return ret;
+
+  int rank, recv_size;
+  MPI_Comm_rank(comm, &rank);
+  bool in_place = (sendbuf == MPI_IN_PLACE);
+
+  string mine;
+  if (!in_place) {
+    int send_size;
+    MPI_Type_size(sendtype, &send_size);
+    SI->SerializeMessage((addr_t)sendbuf, sendcount, send_size, &mine);
+  }
+  vector<string> all;
+  GatherSymbolic(mine, root, &all);
+
+  // The root places slice r at recvbuf[r * recvcount].  (Its own slice
+  // stays in place if it gathered MPI_IN_PLACE.)
+  if (rank == root) {
+    MPI_Type_size(recvtype, &recv_size);
+    for (int r = 0; r < static_cast<int>(all.size()); r++) {
+      if (in_place && (r == root)) continue;
+      Bind((char*)recvbuf + r * recvcount * recv_size, recvcount, recv_size, all[r]);
+    }
+  }
+  return ret;
 }
@@ -11,15 +11,19 @@
 #include <algorithm>
 #include <assert.h>
 #include <ctype.h>
+#include <deque>
 #include <fstream>
-#include <limits>
+#include <pthread.h>
 #include <set>
 #include <sstream>
 #include <stdio.h>
 #include <string>
+#include <unistd.h>
 #include <vector>
 #include <ext/hash_map>
 
+#include "base/program_metadata.h"
+
 using namespace std;
 using __gnu_cxx::hash_map;
 
@@ -38,16 +42,19 @@ namespace __gnu_cxx {
   };
 }
 
-void readBranches(set<int>* branches) {
+void readBranches(set<int>* branches, vector< vector<int> >* functions) {
   ifstream in("branches");
 
   int fid, numBranches;
   while (in >> fid >> numBranches) {
+    functions->push_back(vector<int>());
     for (int i = 0;  i < numBranches; i++) {
       int b1, b2;
       assert(in >> b1 >> b2);
       branches->insert(b1);
       branches->insert(b2);
+      functions->back().push_back(b1);
+      functions->back().push_back(b2);
     }
   }
 
@@ -100,46 +107,95 @@ void readCfg(graph_t* graph) {
   in.close();
 }
 
-void dijkstra_bounded_shortest_paths
-(const graph_t& g, int src, vector<size_t>& dist_map, size_t max_dist) {
-
-  // Initialize all distances.
-  for (int i = 0; i < g.size(); i++) {
-    dist_map[i] = numeric_limits<size_t>::max();
-  }
-  dist_map[src] = 0;
+// Finds the branches one step away from a branch in the thinned graph:
+// those at distance exactly one, where an edge into a branch has length
+// one and any other edge length zero.
+//
+// Each search is a 0-1 BFS that stops at distance one, so it touches only
+// the vertices it reaches.  Distances are stamped with the search they
+// belong to, so nothing is reset between searches.
+class NeighborFinder {
+ public:
+  NeighborFinder(const graph_t& g, const vector<bool>& is_branch)
+    : g_(g), is_branch_(is_branch), epoch_(0),
+      stamp_(g.size(), 0), finished_(g.size(), 0), dist_(g.size()) { }
 
-  // Initialize the queue.
-  set< pair<size_t, int> > Q;
-  Q.insert(make_pair(0, src));
+  // Fills 'nbhrs' with the neighbors of branch 'src', in order.
+  void Find(int src, vector<int>* nbhrs);
 
-  // Initialize the sets of seen and finished vertices.
-  set<int> finished;
+ private:
+  const graph_t& g_;
+  const vector<bool>& is_branch_;
+  unsigned epoch_;
+  vector<unsigned> stamp_;      // dist_[v] is valid iff stamp_[v] == epoch_.
+  vector<unsigned> finished_;
+  vector<unsigned char> dist_;
+  vector<int> reached_;
+  deque<int> Q_;
+};
 
-  while (!Q.empty()) {
-    // Pop the head of the queue.
-    int v = Q.begin()->second;
-    size_t dist = Q.begin()->first;
-    Q.erase(Q.begin());
+void NeighborFinder::Find(int src, vector<int>* nbhrs) {
+  epoch_++;
+  reached_.clear();
+  stamp_[src] = epoch_;
+  dist_[src] = 0;
+  reached_.push_back(src);
+  Q_.push_back(src);
 
-    // If the current distance is greater than the max, we're done.
-    if (dist > max_dist)
-      break;
+  while (!Q_.empty()) {
+    int v = Q_.front();
+    Q_.pop_front();
+    // (A vertex is queued again when a zero-length edge improves it.)
+    if (finished_[v] == epoch_)
+      continue;
+    finished_[v] = epoch_;
 
-    // Otherwise, process the vertex.
-    finished.insert(v);
-    for (const_nbhr_it e = g[v].begin(); e != g[v].end(); ++e) {
+    for (const_nbhr_it e = g_[v].begin(); e != g_[v].end(); ++e) {
       int u = e->first;
-      if (finished.find(u) == finished.end()) {
-        size_t d = dist_map[v] + e->second;
-        if ((d < dist_map[u]) && (d <= max_dist)) {
-          Q.erase(make_pair(dist_map[u], u));
-          Q.insert(make_pair(d, u));
-          dist_map[u] = d;
-        }
+      size_t d = dist_[v] + e->second;
+      if ((d > 1) || (finished_[u] == epoch_))
+        continue;
+      if (stamp_[u] != epoch_) {
+        stamp_[u] = epoch_;
+        reached_.push_back(u);
+      } else if (d >= dist_[u]) {
+        continue;
+      }
+      dist_[u] = d;
+      if (e->second == 0) {
+        Q_.push_front(u);
+      } else {
+        Q_.push_back(u);
       }
     }
   }
+
+  nbhrs->clear();
+  for (size_t i = 0; i < reached_.size(); i++) {
+    int u = reached_[i];
+    if ((dist_[u] == 1) && is_branch_[u])
+      nbhrs->push_back(u);
+  }
+  sort(nbhrs->begin(), nbhrs->end());
+}
+
+// The searches from all the branches, shared out among threads.
+struct ThinningWork {
+  const graph_t* cfg;
+  const vector<bool>* is_branch;
+  const vector<int>* sources;
+  vector< vector<int> >* nbhrs;
+  size_t next;  // The next source to take.
+};
+
+void* thinningWorker(void* arg) {
+  ThinningWork* work = static_cast<ThinningWork*>(arg);
+  NeighborFinder finder(*work->cfg, *work->is_branch);
+  size_t i;
+  while ((i = __sync_fetch_and_add(&work->next, 1)) < work->sources->size()) {
+    finder.Find((*work->sources)[i], &(*work->nbhrs)[i]);
+  }
+  return NULL;
 }
 
 
@@ -147,7 +203,8 @@ int main(void) {
 
   // Read in the set of branches.
   set<int> branches;
-  readBranches(&branches);
+  vector< vector<int> > functions;
+  readBranches(&branches, &functions);
   fprintf(stderr, "Read %d branches.\n", branches.size());
 
   // Read in the CFG.
@@ -168,39 +225,79 @@ int main(void) {
     }
   }
 
+  // Make room for every vertex named, including branches and edge
+  // targets with no edges of their own.
+  size_t num_nodes = cfg.size();
+  if (!branches.empty())
+    num_nodes = max(num_nodes, static_cast<size_t>(*branches.rbegin()) + 1);
+  for (size_t i = 0; i < cfg.size(); i++) {
+    for (const_nbhr_it j = cfg[i].begin(); j != cfg[i].end(); ++j) {
+      num_nodes = max(num_nodes, static_cast<size_t>(j->first) + 1);
+    }
+  }
+  cfg.resize(num_nodes);
+  vector<bool> is_branch(num_nodes, false);
+  for (BranchIt i = branches.begin(); i != branches.end(); ++i) {
+    is_branch[*i] = true;
+  }
+
+  // "Thin" the graph down to unit-length edges between branches by, for
+  // each branch, searching until all other branches distance one away
+  // have been discovered.  The searches are independent, so they run on
+  // one thread per core.
+  vector<int> sources(branches.begin(), branches.end());
+  vector< vector<int> > nbhrs(sources.size());
+  ThinningWork work = { &cfg, &is_branch, &sources, &nbhrs, 0 };
+  long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_threads > static_cast<long>(sources.size()))
+    num_threads = sources.size();
+  if (num_threads < 1)
+    num_threads = 1;
+  vector<pthread_t> threads(num_threads - 1);
+  for (size_t i = 0; i < threads.size(); i++) {
+    if (pthread_create(&threads[i], NULL, thinningWorker, &work)) {
+      threads.resize(i);
+      break;
+    }
+  }
+  thinningWorker(&work);
+  for (size_t i = 0; i < threads.size(); i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // Print out an adjacency list for the thinned graph.
   std::ofstream out("cfg_branches", std::ios::out | std::ios::binary);
   size_t len = branches.size();
   out.write((char*)&len, sizeof(len));
-
-  // "Thin" the graph down to unit-length edges between branches by, for each
-  // branch, running Dijstrak's Algorithm until all other branches distance
-  // one away have been discovered.  We print out an adjacency list for the
-  // thinned graph as we go.
-  vector<size_t> dist(cfg.size());
-  vector<int> nbhrs;
   int numEdges = 0;
-  for (BranchIt i = branches.begin(); i != branches.end(); ++i) {
-    // Compute all shortest-paths of length zero and one from vertex i.
-    dijkstra_bounded_shortest_paths(cfg, *i, dist, 1);
-
-    // Accumulate the branch nodes distance one from i.
-    nbhrs.clear();
-    for (BranchIt j = branches.begin(); j != branches.end(); ++j) {
-      if (dist[*j] == 1) {
-	nbhrs.push_back(*j);
-      }
-    }
-    numEdges += nbhrs.size();
-
-    // Write out the neighbors.
-    len = nbhrs.size();
-    int dest = *i;
+  for (size_t i = 0; i < sources.size(); i++) {
+    numEdges += nbhrs[i].size();
+    len = nbhrs[i].size();
+    int dest = sources[i];
     out.write((char*)&dest, sizeof(dest));
     out.write((char*)&len, sizeof(len));
-    out.write((char*)&nbhrs.front(), len * sizeof(int));
+    if (len > 0)
+      out.write((char*)&nbhrs[i].front(), len * sizeof(int));
   }
 
   out.close();
   fprintf(stderr, "Wrote %d branch edges.\n", numEdges);
+
+  // Bundle the branches and the thinned CFG for run_crest.
+  {
+    vector< pair<int, vector<int> > > thinned(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+      thinned[i].first = sources[i];
+      thinned[i].second.swap(nbhrs[i]);
+    }
+    string bundle;
+    crest::ProgramMetadata::Serialize(functions, thinned, &bundle);
+    std::ofstream meta(crest::ProgramMetadata::kFile, std::ios::out | std::ios::binary);
+    meta.write(bundle.data(), bundle.size());
+    if (!meta) {
+      fprintf(stderr, "Failed to write %s.\n", crest::ProgramMetadata::kFile);
+      return 1;
+    }
+  }
   return 0;
 }
@@ -9,16 +9,24 @@
 // for details.
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <functional>
 #include <limits>
-#include <queue>
 #include <utility>
 
+#include "base/fork_server.h"
 #include "base/yices_solver.h"
 #include "run_crest/concolic_search.h"
 
@@ -42,7 +50,8 @@ using std::max;
 using std::min;
 using std::numeric_limits;
 using std::pair;
-using std::queue;
+using std::pop_heap;
+using std::push_heap;
 using std::random_shuffle;
 using std::stable_sort;
 
@@ -56,60 +65,89 @@ struct ScoredBranchComp : public binary_function<ScoredBranch, ScoredBranch, boo
   bool operator()(const ScoredBranch& a, const ScoredBranch& b) const { return (a.second < b.second); }
 };
 
+// The constraints of a path, to be forced in order of increasing score,
+// with ties in the order they were added.  It is a heap, built in linear
+// time, so a search that gives up after the first few candidates does
+// not pay to sort the whole path.
+class CandidateQueue {
+ public:
+  void Add(size_t idx, int score) {
+    Candidate c = { score, heap_.size(), idx };
+    heap_.push_back(c);
+  }
+
+  void Build() { make_heap(heap_.begin(), heap_.end(), Later()); }
+
+  // Removes the next candidate into 'b', or returns false if none is left.
+  bool Pop(ScoredBranch* b) {
+    if (heap_.empty()) return false;
+    pop_heap(heap_.begin(), heap_.end(), Later());
+    b->first = heap_.back().idx;
+    b->second = heap_.back().score;
+    heap_.pop_back();
+    return true;
+  }
+
+ private:
+  struct Candidate {
+    int score;
+    size_t seq;
+    size_t idx;
+  };
+
+  struct Later : public binary_function<Candidate, Candidate, bool> {
+    bool operator()(const Candidate& a, const Candidate& b) const {
+      return (a.score > b.score) || ((a.score == b.score) && (a.seq > b.seq));
+    }
+  };
+
+  vector<Candidate> heap_;
+};
+
 }  // namespace
 
 ////////////////////////////////////////////////////////////////////////
 //// Search ////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
+// The absolute path to 'program', as the program is run from other
+// directories.  (A name that is not a file here is left for mpirun to
+// find on the PATH.)
+static string AbsolutePath(const string& program) {
+  char* path = realpath(program.c_str(), NULL);
+  if (!path) return program;
+  string ret(path);
+  free(path);
+  return ret;
+}
+
 Search::Search(const string& program, int max_iterations, int num_mpi_procs)
-    : program_(program), max_iters_(max_iterations), num_iters_(0), num_mpi_procs_(num_mpi_procs) {
+    : log_new_coverage_(false),
+      program_(AbsolutePath(program)),
+      max_iters_(max_iterations),
+      num_iters_(0),
+      num_mpi_procs_(num_mpi_procs),
+      fork_server_(false),
+      server_pid_(-1),
+      transport_kind_(transport::FILES),
+      transport_(NULL),
+      coverage_(NULL),
+      coverage_log_(NULL) {
 
   start_time_ = time(NULL);
 
-  {  // Read in the set of branches.
-    max_branch_ = 0;
-    max_function_ = 0;
-    branches_.reserve(100000);
-    branch_count_.reserve(100000);
-    branch_count_.push_back(0);
-
-    ifstream in("branches");
-    assert(in);
-    function_id_t fid;
-    int numBranches;
-    while (in >> fid >> numBranches) {
-      branch_count_.push_back(2 * numBranches);
-      branch_id_t b1, b2;
-      for (int i = 0; i < numBranches; i++) {
-        assert(in >> b1 >> b2);
-        branches_.push_back(b1);
-        branches_.push_back(b2);
-        max_branch_ = max(max_branch_, max(b1, b2));
-      }
-    }
-    in.close();
-    max_branch_++;
-    max_function_ = branch_count_.size();
-  }
-
-  // Compute the paired-branch map.
-  paired_branch_.resize(max_branch_);
-  for (size_t i = 0; i < branches_.size(); i += 2) {
-    paired_branch_[branches_[i]] = branches_[i + 1];
-    paired_branch_[branches_[i + 1]] = branches_[i];
-  }
-
-  // Compute the branch-to-function map.
-  branch_function_.resize(max_branch_);
-  {
-    size_t i = 0;
-    for (function_id_t j = 0; j < branch_count_.size(); j++) {
-      for (size_t k = 0; k < branch_count_[j]; k++) {
-        branch_function_[branches_[i++]] = j;
-      }
-    }
+  // Read in the branches: from the bundle written by process_cfg, or,
+  // for a program instrumented before there was one, from the text files.
+  if (!metadata_.Open(ProgramMetadata::kFile) && !metadata_.ReadTextFiles("branches", "cfg_branches")) {
+    fprintf(stderr, "Failed to read the branches of %s.\n", program_.c_str());
+    exit(-1);
   }
+  max_branch_ = metadata_.max_branch();
+  max_function_ = metadata_.num_functions();
+  branches_.assign(metadata_.branches(), metadata_.branches() + metadata_.num_branches());
+  branch_count_.assign(metadata_.branch_count(), metadata_.branch_count() + max_function_);
+  paired_branch_.assign(metadata_.paired_branch(), metadata_.paired_branch() + max_branch_);
+  branch_function_.assign(metadata_.branch_function(), metadata_.branch_function() + max_branch_);
 
   // Initialize all branches to "uncovered" (and functions to "unreached").
   total_num_covered_ = num_covered_ = 0;
@@ -118,6 +156,10 @@ Search::Search(const string& program, int max_iterations, int num_mpi_procs)
   total_covered_.resize(max_branch_, false);
   reached_.resize(max_function_, false);
 
+  seen_epoch_ = 0;
+  seen_count_.resize(max_branch_, 0);
+  seen_stamp_.resize(max_branch_, 0);
+
 #if 0
   { // Read in any previous coverage (for faster debugging).
     ifstream in("coverage");
@@ -140,12 +182,14 @@ Search::Search(const string& program, int max_iterations, int num_mpi_procs)
   // Print out the initial coverage.
   fprintf(stderr, "Iteration 0 (0s): covered %u branches [%u reach funs, %u reach branches].\n", num_covered_,
           reachable_functions_, reachable_branches_);
-
-  // Sort the branches.
-  sort(branches_.begin(), branches_.end());
 }
 
-Search::~Search() {}
+Search::~Search() {
+  StopForkServer();
+  delete transport_;
+  delete coverage_;
+  if (coverage_log_) fclose(coverage_log_);
+}
 
 void Search::WriteInputToFileOrDie(const string& file, const vector<value_t>& input) {
   FILE* f = fopen(file.c_str(), "w");
@@ -162,60 +206,184 @@ void Search::WriteInputToFileOrDie(const string& file, const vector<value_t>& in
   fclose(f);
 }
 
-void Search::WriteCoverageToFileOrDie(const string& file) {
-  FILE* f = fopen(file.c_str(), "w");
-  if (!f) {
-    fprintf(stderr, "Failed to open %s.\n", file.c_str());
-    perror("Error: ");
-    exit(-1);
+void Search::LogCoverageOrDie(branch_id_t bid) {
+  if (!coverage_log_) {
+    coverage_log_ = fopen("coverage", "w");
+    if (!coverage_log_) {
+      fprintf(stderr, "Failed to open coverage.\n");
+      perror("Error: ");
+      exit(-1);
+    }
   }
+  fprintf(coverage_log_, "%d\n", bid);
+}
 
-  for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
-    if (total_covered_[*i]) {
-      fprintf(f, "%d\n", *i);
+// Has the fork server's mpirun exited?  (Reaps it if so.)
+static bool ServerExited(pid_t pid) {
+  int status;
+  return (waitpid(pid, &status, WNOHANG) == pid);
+}
+
+void Search::StartForkServer() {
+  using namespace fork_server;
+
+  for (int i = 0; i < num_mpi_procs_; i++) {
+    unlink(CommandFifo(i).c_str());
+    unlink(ReplyFifo(i).c_str());
+    if (mkfifo(CommandFifo(i).c_str(), 0600) || mkfifo(ReplyFifo(i).c_str(), 0600)) {
+      perror("Failed to create fork server FIFOs");
+      exit(-1);
     }
   }
 
-  fclose(f);
+  // The shared-memory transport keeps state that the forked children
+  // leave stale, so the server talks TCP, whose connections are made
+  // lazily by each child.
+  char command[512] = {0};
+  snprintf(command, sizeof(command), "exec mpirun --mca btl self,tcp -x %s=1 -n %d %s", kEnvVar, num_mpi_procs_, program_.c_str());
+  server_pid_ = fork();
+  assert(server_pid_ != -1);
+  if (!server_pid_) {
+    transport_->Export();
+    execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+    perror("Failed to start fork server");
+    _exit(-1);
+  }
+
+  // Each rank opens its FIFOs in the same order, once it reaches
+  // MPI_Init, and then reports ready.  Our ends are opened without
+  // blocking, so that a job that dies first (from a bad program path, a
+  // failed exec, or a crash in startup code) is reported, not waited for
+  // forever.
+  for (int i = 0; i < num_mpi_procs_; i++) {
+    int cmd_fd;
+    while ((cmd_fd = open(CommandFifo(i).c_str(), O_WRONLY | O_NONBLOCK)) < 0) {
+      // (ENXIO until the rank opens its end.)
+      if (errno != ENXIO) {
+        perror("Failed to open fork server FIFOs");
+        exit(-1);
+      }
+      if (ServerExited(server_pid_)) {
+        fprintf(stderr, "Fork server exited before rank %d started.\n", i);
+        exit(-1);
+      }
+      usleep(1000);
+    }
+    int reply_fd = open(ReplyFifo(i).c_str(), O_RDONLY | O_NONBLOCK);
+    if (reply_fd < 0) {
+      perror("Failed to open fork server FIFOs");
+      exit(-1);
+    }
+
+    struct pollfd pfd;
+    pfd.fd = reply_fd;
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, 100) <= 0) {
+      if (ServerExited(server_pid_)) {
+        fprintf(stderr, "Fork server exited before rank %d started.\n", i);
+        exit(-1);
+      }
+    }
+    fcntl(cmd_fd, F_SETFL, 0);
+    fcntl(reply_fd, F_SETFL, 0);
+    int ready;
+    if (!ReadAll(reply_fd, &ready, sizeof(ready))) {
+      fprintf(stderr, "Fork server rank %d failed to start.\n", i);
+      exit(-1);
+    }
+
+    server_cmd_fds_.push_back(cmd_fd);
+    server_reply_fds_.push_back(reply_fd);
+  }
+
+  // A dead fork server must not kill us on the next write.
+  signal(SIGPIPE, SIG_IGN);
+}
+
+void Search::StopForkServer() {
+  if (server_pid_ <= 0) return;
+
+  // End-of-file on the command FIFOs shuts the server down.
+  for (int i = 0; i < num_mpi_procs_; i++) {
+    close(server_cmd_fds_[i]);
+    close(server_reply_fds_[i]);
+    unlink(fork_server::CommandFifo(i).c_str());
+    unlink(fork_server::ReplyFifo(i).c_str());
+  }
+  waitpid(server_pid_, NULL, 0);
+  server_cmd_fds_.clear();
+  server_reply_fds_.clear();
+  server_pid_ = -1;
 }
 
 int runCount = 0;
 void Search::LaunchProgram(const vector<value_t>& inputs) {
-  WriteInputToFileOrDie("input", inputs);
+  if (!transport_) {
+    transport_ = TransportServer::Create(transport_kind_, num_mpi_procs_);
+    // (Exported before any fork server starts, so that it inherits it.)
+    coverage_ = CoverageMap::Create(max_branch_, "0");
+    if (coverage_) coverage_->Export();
+  }
+  transport_->SendInput(inputs);
+  if (coverage_) coverage_->Clear();
 
-  /*
+  if (fork_server_) {
+    if (server_pid_ <= 0) StartForkServer();
+
+    // Start all ranks, then wait for all of them to finish.
+    bool ok = true;
+    for (int i = 0; i < num_mpi_procs_; i++) {
+      ok = ok && fork_server::WriteRunCommand(server_cmd_fds_[i], inputs);
+    }
+    for (int i = 0; i < num_mpi_procs_; i++) {
+      int status;
+      transport_->WaitFor(vector<int>(1, server_reply_fds_[i]));
+      ok = ok && fork_server::ReadAll(server_reply_fds_[i], &status, sizeof(status));
+    }
+    if (!ok) {
+      fprintf(stderr, "Lost connection to the fork server.\n");
+      exit(-1);
+    }
+    return;
+  }
+
+  // The write end of 'done' is held by the MPI job, so it reads as
+  // closed once the job is over.
+  int done[2];
+  if (pipe(done)) {
+    perror("Failed to launch program");
+    exit(-1);
+  }
+
+  char command[512] = {0};
+  snprintf(command, sizeof(command), "mpirun -n %d %s", num_mpi_procs_, program_.c_str());
   pid_t pid = fork();
   assert(pid != -1);
-
   if (!pid) {
-    system(program_.c_str());
-    exit(0);
+    close(done[0]);
+    transport_->Export();
+    execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+    _exit(-1);
   }
-  */
 
-  char command[512] = {0};
-  sprintf(command, "mpirun -n %d %s", num_mpi_procs_, program_.c_str());
-  system(command);
+  close(done[1]);
+  transport_->WaitFor(vector<int>(1, done[0]));
+  close(done[0]);
+  waitpid(pid, NULL, 0);
 }
 
 void Search::RunProgram(const vector<value_t>& inputs, SymbolicExecution* ex) {
-  if (++num_iters_ > max_iters_) {
+  if (!TakeIteration()) {
     // TODO(jburnim): Devise a better system for capping the iterations.
+    StopForkServer();
+    delete transport_;
+    transport_ = NULL;
     exit(0);
   }
 
   // Run the program.
   LaunchProgram(inputs);
-
-  // Read the execution from the program.
-  // Want to do this with sockets.  (Currently doing it with files.)
-  ifstream in("szd_execution", ios::in | ios::binary);
-  assert(in && ex->Parse(in));
-  in.close();
-
-  if (ex->inputs().size() > 0) {
-    WriteInputToFileOrDie("input" + patch::to_string(runCount++), ex->inputs());
-  }
+  FinishProgram(transport_, coverage_, ex);
 
   /*
   for (size_t i = 0; i < ex->path().branches().size(); i++) {
@@ -225,42 +393,129 @@ void Search::RunProgram(const vector<value_t>& inputs, SymbolicExecution* ex) {
   */
 }
 
+bool Search::TakeIteration() {
+  if (num_iters_ >= max_iters_) return false;
+  num_iters_++;
+  return true;
+}
+
+pid_t Search::StartProgram(const string& dir, TransportServer* server, CoverageMap* coverage,
+                           const vector<value_t>& inputs) {
+  server->SendInput(inputs);
+  if (coverage) coverage->Clear();
+
+  char command[512] = {0};
+  snprintf(command, sizeof(command), "mpirun -n %d %s", num_mpi_procs_, program_.c_str());
+  pid_t pid = fork();
+  assert(pid != -1);
+  if (!pid) {
+    if (chdir(dir.c_str())) _exit(-1);
+    server->Export();
+    if (coverage) coverage->Export();
+    execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+    _exit(-1);
+  }
+  return pid;
+}
+
+void Search::FinishProgram(TransportServer* server, const CoverageMap* coverage, SymbolicExecution* ex) {
+  // Read the executions of all ranks, merged into one.
+  if (!server->ReceiveExecution(&last_run_)) {
+    fprintf(stderr, "Failed to read the execution of %s.\n", program_.c_str());
+    exit(-1);
+  }
+  ex->Swap(*last_run_.mutable_execution());
+  if (coverage) {
+    ex->mutable_coverage()->clear();
+    coverage->Collect(ex->mutable_coverage());
+  }
+
+  if (ex->inputs().size() > 0) {
+    WriteInputToFileOrDie("input" + patch::to_string(runCount++), ex->inputs());
+  }
+}
+
 bool Search::UpdateCoverage(const SymbolicExecution& ex) { return UpdateCoverage(ex, NULL); }
 
 bool Search::UpdateCoverage(const SymbolicExecution& ex, set<branch_id_t>* new_branches) {
 
   const unsigned int prev_covered_ = num_covered_;
-  const vector<branch_id_t>& branches = ex.path().branches();
-  for (BranchIt i = branches.begin(); i != branches.end(); ++i) {
-    if ((*i > 0) && !covered_[*i]) {
-      covered_[*i] = true;
-      num_covered_++;
-      if (new_branches) {
-        new_branches->insert(*i);
-      }
-      if (!reached_[branch_function_[*i]]) {
-        reached_[branch_function_[*i]] = true;
-        reachable_functions_++;
-        reachable_branches_ += branch_count_[branch_function_[*i]];
-      }
+  if (ex.has_coverage()) {
+    // Straight from the coverage map, without walking the path.
+    const vector<branch_id_t>& branches = ex.coverage();
+    for (BranchIt i = branches.begin(); i != branches.end(); ++i) {
+      CoverBranch(*i, new_branches);
     }
-    if ((*i > 0) && !total_covered_[*i]) {
-      total_covered_[*i] = true;
-      total_num_covered_++;
+  } else {
+    const vector<branch_id_t>& branches = ex.path().branches();
+    for (BranchIt i = branches.begin(); i != branches.end(); ++i) {
+      CoverBranch(*i, new_branches);
     }
   }
+  // The branches covered before the path began.  (The coverage map can
+  // miss these: a fork server runs them once, before the map is cleared
+  // for the next run.)
+  const vector<bool>& prefix = ex.path().prefix_covered();
+  for (size_t i = 0; i < prefix.size(); i++) {
+    if (prefix[i]) CoverBranch(static_cast<branch_id_t>(i), new_branches);
+  }
 
   fprintf(stderr, "Iteration %d (%lds): covered %u branches [%u reach funs, %u reach branches].\n", num_iters_,
           time(NULL) - start_time_, total_num_covered_, reachable_functions_, reachable_branches_);
 
   bool found_new_branch = (num_covered_ > prev_covered_);
-  if (found_new_branch) {
-    WriteCoverageToFileOrDie("coverage");
-  }
+  if (coverage_log_) fflush(coverage_log_);
 
   return found_new_branch;
 }
 
+void Search::CoverBranch(branch_id_t bid, set<branch_id_t>* new_branches) {
+  if ((bid > 0) && !covered_[bid]) {
+    covered_[bid] = true;
+    num_covered_++;
+    if (log_new_coverage_) {
+      new_coverage_.push_back(bid);
+    }
+    if (new_branches) {
+      new_branches->insert(bid);
+    }
+    if (!reached_[branch_function_[bid]]) {
+      reached_[branch_function_[bid]] = true;
+      reachable_functions_++;
+      reachable_branches_ += branch_count_[branch_function_[bid]];
+    }
+  }
+  if ((bid > 0) && !total_covered_[bid]) {
+    total_covered_[bid] = true;
+    total_num_covered_++;
+    LogCoverageOrDie(bid);
+  }
+}
+
+void Search::ResetSeenCounts() {
+  if (++seen_epoch_ == 0) {
+    // The stamps wrapped around.
+    seen_stamp_.assign(seen_stamp_.size(), 0);
+    seen_epoch_ = 1;
+  }
+}
+
+unsigned Search::CountSeen(branch_id_t bid) {
+  if (seen_stamp_[bid] != seen_epoch_) {
+    seen_stamp_[bid] = seen_epoch_;
+    seen_count_[bid] = 0;
+  }
+  return seen_count_[bid]++;
+}
+
+void Search::ShuffledConstraints(const SymbolicExecution& ex, size_t pos, vector<size_t>* order) {
+  order->resize(ex.path().num_constraints() - pos);
+  for (size_t i = 0; i < order->size(); i++) {
+    (*order)[i] = i + pos;
+  }
+  random_shuffle(order->begin(), order->end());
+}
+
 void Search::RandomInput(const map<var_t, type_t>& vars, vector<value_t>* input) {
   input->resize(vars.size());
 
@@ -304,22 +559,48 @@ void Search::RandomInput(const map<var_t, type_t>& vars, vector<value_t>* input)
 }
 
 bool Search::SolveAtBranch(const SymbolicExecution& ex, size_t branch_idx, vector<value_t>* input) {
+  return SolveAtBranch(ex, branch_idx, NULL, input);
+}
 
-  const vector<SymbolicPred*>& constraints = ex.path().constraints();
+bool Search::SolveAtBranch(const SymbolicExecution& ex, size_t branch_idx, YicesSession* session,
+                           vector<value_t>* input) {
 
-  // Optimization: If any of the previous constraints are idential to the
-  // branch_idx-th constraint, immediately return false.
-  for (int i = static_cast<int>(branch_idx) - 1; i >= 0; i--) {
-    if (constraints[branch_idx]->Equal(*constraints[i])) return false;
-  }
+  const SymbolicPath& path = ex.path();
+
+  // Optimization: If any of the previous constraints are identical to the
+  // branch_idx-th constraint, its negation is unsatisfiable, so
+  // immediately return false.  If any is its negation, the path is
+  // inconsistent (the symbolic constraints missed some concrete effect,
+  // such as overflow), and we cannot predict where the new input goes.
+  if (path.HasEarlierDuplicate(branch_idx) || path.HasEarlierNegation(branch_idx)) return false;
 
-  vector<const SymbolicPred*> cs(constraints.begin(), constraints.begin() + branch_idx + 1);
+  // Only the variables that the new constraint depends on get new
+  // values.  The others keep the values they had in 'ex', which satisfy
+  // the constraints they appear in.
+  vector<size_t> slice_idx;
+  vector<var_t> slice_vars;
+  path.DependentSlice(branch_idx, &slice_idx, &slice_vars);
+
+  // Only here, where the solver needs them, are predicates built.
   map<var_t, value_t> soln;
-  constraints[branch_idx]->Negate();
+  path.constraint(branch_idx)->Negate();
   // fprintf(stderr, "Yices . . . ");
-  bool success = YicesSolver::IncrementalSolve(ex.inputs(), ex.vars(), cs, &soln);
+  bool success;
+  if (session) {
+    map<var_t, type_t> dependent_vars;
+    for (size_t i = 0; i < slice_vars.size(); i++) {
+      dependent_vars.insert(*ex.vars().find(slice_vars[i]));
+    }
+    success = session->Check(ex.vars(), *path.constraint(branch_idx), dependent_vars, &soln);
+  } else {
+    vector<const SymbolicPred*> slice(slice_idx.size());
+    for (size_t i = 0; i < slice_idx.size(); i++) {
+      slice[i] = path.constraint(slice_idx[i]);
+    }
+    success = YicesSolver::SolveSlice(ex.vars(), slice_vars, slice, &soln);
+  }
   // fprintf(stderr, "%d\n", success);
-  constraints[branch_idx]->Negate();
+  path.constraint(branch_idx)->Negate();
 
   if (success) {
     // Merge the solution with the previous input to get the next
@@ -367,7 +648,8 @@ void BoundedDepthFirstSearch::Run() {
   RunProgram(vector<value_t>(), &ex);
   UpdateCoverage(ex);
 
-  DFS(0, max_depth_, ex);
+  YicesSession session;
+  DFS(0, max_depth_, ex, &session);
   // DFS(0, ex);
 }
 
@@ -378,7 +660,7 @@ vector<value_t> input;
 
 const SymbolicPath& path = prev_ex.path();
 
-int last = min(max_depth_, static_cast<int>(path.constraints().size()) - 1);
+int last = min(max_depth_, static_cast<int>(path.num_constraints()) - 1);
 for (int i = last; i >= depth; i--) {
   // Solve constraints[0..i].
   if (!SolveAtBranch(prev_ex, i, &input)) {
@@ -402,15 +684,30 @@ for (int i = last; i >= depth; i--) {
 }
 */
 
-void BoundedDepthFirstSearch::DFS(size_t pos, int depth, SymbolicExecution& prev_ex) {
+// Does 'cur' start with constraints [0..i] of 'prev'?
+static bool SamePrefix(const SymbolicPath& prev, const SymbolicPath& cur, size_t i) {
+  if (cur.num_constraints() <= i) return false;
+  for (size_t j = 0; j <= i; j++) {
+    if (!prev.constraint(j)->Equal(*cur.constraint(j))) return false;
+  }
+  return true;
+}
+
+// On entry, 'session' holds constraints [0..pos-1] of prev_ex.  Every
+// assertion made here is retracted before returning.
+void BoundedDepthFirstSearch::DFS(size_t pos, int depth, SymbolicExecution& prev_ex, YicesSession* session) {
   SymbolicExecution cur_ex;
   vector<value_t> input;
 
   const SymbolicPath& path = prev_ex.path();
 
-  for (size_t i = pos; (i < path.constraints().size()) && (depth > 0); i++) {
+  session->Push();
+  for (size_t i = pos; (i < path.num_constraints()) && (depth > 0); i++) {
+    // Extend the asserted prefix to constraints[0..i-1].
+    if (i > pos) session->Assert(prev_ex.vars(), *path.constraint(i - 1));
+
     // Solve constraints[0..i].
-    if (!SolveAtBranch(prev_ex, i, &input)) {
+    if (!SolveAtBranch(prev_ex, i, session, &input)) {
       continue;
     }
 
@@ -427,7 +724,298 @@ void BoundedDepthFirstSearch::DFS(size_t pos, int depth, SymbolicExecution& prev
 
     // We successfully solved the branch, recurse.
     depth--;
-    DFS(i + 1, depth, cur_ex);
+
+    // The new path normally starts with our prefix and the negated
+    // constraint, so the session only needs the latter.  But the
+    // new concrete values can change constraints in the prefix (where
+    // non-linear terms were concretized), and then cur_ex gets a session
+    // of its own.
+    path.constraint(i)->Negate();
+    bool same = SamePrefix(path, cur_ex.path(), i);
+    if (same) {
+      session->Push();
+      session->Assert(prev_ex.vars(), *path.constraint(i));
+    }
+    path.constraint(i)->Negate();
+
+    if (same) {
+      DFS(i + 1, depth, cur_ex, session);
+      session->Pop();
+    } else if (cur_ex.path().num_constraints() > i) {
+      YicesSession cur_session;
+      for (size_t j = 0; j <= i; j++) {
+        cur_session.Assert(cur_ex.vars(), *cur_ex.path().constraint(j));
+      }
+      DFS(i + 1, depth, cur_ex, &cur_session);
+    }
+  }
+  session->Pop();
+}
+
+////////////////////////////////////////////////////////////////////////
+//// GenerationalSearch ////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+GenerationalSearch::GenerationalSearch(const string& program, int max_iterations, int num_mpi_procs, int num_jobs)
+    : Search(program, max_iterations, num_mpi_procs),
+      num_jobs_(num_jobs),
+      slots_(num_jobs),
+      num_running_(0),
+      explore_receives_(false),
+      num_steals_(0),
+      num_pred_fails_(0),
+      num_repeats_(0),
+      num_reorders_(0) {
+
+  for (int k = 0; k < num_jobs_; k++) {
+    Slot& slot = slots_[k];
+    slot.pid = -1;
+    slot.dir = "crest_job." + patch::to_string(k);
+    if (mkdir(slot.dir.c_str(), 0755) && (errno != EEXIST)) {
+      fprintf(stderr, "Failed to create %s.\n", slot.dir.c_str());
+      perror("Error: ");
+      exit(-1);
+    }
+    // (The transport is created at the first launch, once its kind is set.)
+    slot.transport = NULL;
+    slot.coverage = CoverageMap::Create(max_branch_, patch::to_string(k));
+  }
+}
+
+GenerationalSearch::~GenerationalSearch() {
+  for (size_t k = 0; k < slots_.size(); k++) {
+    delete slots_[k].transport;
+    delete slots_[k].coverage;
+    for (size_t i = 0; i < slots_[k].frontier.size(); i++) {
+      delete slots_[k].frontier[i];
+    }
+  }
+}
+
+void GenerationalSearch::Run() {
+  // Initial execution (on empty inputs).
+  slots_[0].ready.push_back(Child());
+  slots_[0].ready.back().parent = NULL;
+  slots_[0].ready.back().idx = 0;
+  slots_[0].ready.back().reorder = false;
+
+  bool out_of_iterations = false;
+  while (true) {
+    // Fill the idle slots.
+    for (size_t k = 0; (k < slots_.size()) && !out_of_iterations; k++) {
+      if (slots_[k].pid != -1) continue;
+      if (slots_[k].ready.empty() && !SolveFor(k)) continue;
+      if (!TakeIteration()) {
+        out_of_iterations = true;
+        break;
+      }
+      Launch(k);
+    }
+    if (num_running_ == 0) break;
+
+    // Solve ahead for a busy slot, checking for finished executions in
+    // between.  With nothing left to solve, just wait.
+    bool solved = false;
+    for (size_t k = 0; (k < slots_.size()) && !out_of_iterations && !solved; k++) {
+      if ((slots_[k].pid != -1) && slots_[k].ready.empty()) solved = SolveFor(k);
+    }
+    Reap(!solved);
+  }
+
+  fprintf(stderr, "Generational search: %u steals, %u prediction failures, %u repeated queries skipped, "
+          "%u receive reorderings.\n", num_steals_, num_pred_fails_, num_repeats_, num_reorders_);
+}
+
+// The best execution in slot k's frontier, or, if it is empty, the best
+// execution stolen from another slot.  NULL if there are none.
+GenerationalSearch::Node* GenerationalSearch::TopOrSteal(size_t k) {
+  vector<Node*>& mine = slots_[k].frontier;
+  if (!mine.empty()) return mine.front();
+
+  size_t victim = k;
+  for (size_t j = 0; j < slots_.size(); j++) {
+    const vector<Node*>& theirs = slots_[j].frontier;
+    if (theirs.empty()) continue;
+    if ((victim == k) || (slots_[victim].frontier.front()->score < theirs.front()->score)) victim = j;
+  }
+  if (victim == k) return NULL;
+
+  vector<Node*>& theirs = slots_[victim].frontier;
+  pop_heap(theirs.begin(), theirs.end(), NodeLess());
+  mine.push_back(theirs.back());
+  theirs.pop_back();
+  num_steals_++;
+  return mine.front();
+}
+
+// Solves for the next input of slot k, from its best execution with
+// constraints left to negate (or, first, receive matches left to try).
+bool GenerationalSearch::SolveFor(size_t k) {
+  vector<Node*>& frontier = slots_[k].frontier;
+  vector<value_t> input;
+
+  Node* node;
+  while ((node = TopOrSteal(k)) != NULL) {
+    if (!node->alternatives.empty()) {
+      slots_[k].ready.push_back(Child());
+      Child& child = slots_[k].ready.back();
+      child.input = node->ex.inputs();
+      child.parent = node;
+      child.idx = 0;
+      child.reorder = true;
+      child.schedule.swap(node->alternatives.back());
+      node->alternatives.pop_back();
+      node->num_children++;
+      num_reorders_++;
+      return true;
+    }
+
+    if (node->next >= node->ex.path().num_constraints()) {
+      pop_heap(frontier.begin(), frontier.end(), NodeLess());
+      frontier.pop_back();
+      node->in_frontier = false;
+      Release(node);
+      continue;
+    }
+
+    size_t i = node->next++;
+    if (!tried_.insert(node->ex.path().NegationFingerprint(i)).second) {
+      num_repeats_++;
+      continue;
+    }
+    if (SolveAtBranch(node->ex, i, &input)) {
+      slots_[k].ready.push_back(Child());
+      Child& child = slots_[k].ready.back();
+      child.input.swap(input);
+      child.parent = node;
+      child.idx = i;
+      child.reorder = false;
+      child.schedule = node->schedule;
+      node->num_children++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void GenerationalSearch::Launch(size_t k) {
+  Slot& slot = slots_[k];
+  slot.running = slot.ready.front();
+  slot.ready.pop_front();
+  WriteScheduleOrDie(slot.dir, slot.running.schedule);
+  if (!slot.transport) slot.transport = TransportServer::Create(transport_kind(), num_mpi_procs(), slot.dir);
+  slot.pid = StartProgram(slot.dir, slot.transport, slot.coverage, slot.running.input);
+  num_running_++;
+}
+
+// Collects finished executions (waiting for one if 'block'), and adds
+// each to the frontier of the slot it ran in.
+void GenerationalSearch::Reap(bool block) {
+  while (num_running_ > 0) {
+    pid_t pid = waitpid(-1, NULL, block ? 0 : WNOHANG);
+    if ((pid < 0) && (errno == EINTR)) continue;
+    if (pid <= 0) return;
+    block = false;
+
+    for (size_t k = 0; k < slots_.size(); k++) {
+      Slot& slot = slots_[k];
+      if (slot.pid != pid) continue;
+      slot.pid = -1;
+      num_running_--;
+
+      Node* node = new Node();
+      FinishProgram(slot.transport, slot.coverage, &node->ex);
+
+      Node* parent = slot.running.parent;
+      bool reorder = slot.running.reorder;
+      if (parent && !reorder) {
+        size_t branch_idx = parent->ex.path().constraints_idx()[slot.running.idx];
+        if (!CheckPrediction(parent->ex, node->ex, branch_idx)) {
+          // Kept anyway: it may still lead somewhere new.
+          fprintf(stderr, "Prediction failed!\n");
+          num_pred_fails_++;
+        }
+      }
+      if (parent) {
+        parent->num_children--;
+        Release(parent);
+      }
+
+      set<branch_id_t> new_branches;
+      UpdateCoverage(node->ex, &new_branches);
+      // (With another schedule, the path can change anywhere, so every
+      // constraint is a candidate; the ones already tried are skipped.)
+      node->next = (parent && !reorder) ? (slot.running.idx + 1) : 0;
+      node->score = new_branches.size();
+      node->in_frontier = true;
+      node->num_children = 0;
+      node->schedule.swap(slot.running.schedule);
+      if (explore_receives_) FindAlternatives(node);
+      slot.frontier.push_back(node);
+      push_heap(slot.frontier.begin(), slot.frontier.end(), NodeLess());
+      break;
+    }
+  }
+}
+
+// Frees 'node' once it is out of the frontier and its children have run.
+void GenerationalSearch::Release(Node* node) {
+  if (!node->in_frontier && (node->num_children == 0)) delete node;
+}
+
+// Fills in the alternative schedules of 'node': for each wildcard receive
+// R of a rank, and each other rank whose first message to R's rank after
+// R (with a tag R accepts) was sent without knowing of R (see
+// base/receive_schedule.h), a schedule forcing R to match that rank, and
+// the rank's earlier wildcard receives to match as they did.  Matchings
+// reached before, for the same input, are skipped, so each interleaving
+// of the sends is explored once rather than every order of every
+// receive.
+void GenerationalSearch::FindAlternatives(Node* node) {
+  const vector<RecvEvent>& recvs = node->ex.receives();
+  fingerprint_t input_fp = 0;
+  for (size_t i = 0; i < node->ex.inputs().size(); i++) {
+    input_fp = MixFingerprint(input_fp, node->ex.inputs()[i]);
+  }
+
+  // The receives of each rank are contiguous, in order.
+  for (size_t begin = 0, end; begin < recvs.size(); begin = end) {
+    const int rank = recvs[begin].rank;
+    for (end = begin; (end < recvs.size()) && (recvs[end].rank == rank); end++) { }
+
+    // The schedule, with the matches of the rank's wildcard receives so
+    // far in place of any it was forced to.
+    vector<ForcedMatch> prefix;
+    for (size_t i = 0; i < node->schedule.size(); i++) {
+      if (node->schedule[i].rank != rank) prefix.push_back(node->schedule[i]);
+    }
+    fingerprint_t fp = MixFingerprint(input_fp, rank);
+    unsigned index = 0;
+
+    for (size_t i = begin; i < end; i++) {
+      const RecvEvent& r = recvs[i];
+      if (!r.wildcard) continue;
+
+      set<int> sources;
+      sources.insert(r.source);
+      for (size_t j = i + 1; j < end; j++) {
+        const RecvEvent& m = recvs[j];
+        if (!r.any_tag && (m.tag != r.tag)) continue;
+        if (!sources.insert(m.source).second) continue;
+        if (m.send_clock >= r.clock) continue;
+        if (!matched_.insert(MixFingerprint(fp, m.source + 1)).second) continue;
+
+        ForcedMatch alt = { rank, index, m.source };
+        node->alternatives.push_back(prefix);
+        node->alternatives.back().push_back(alt);
+      }
+
+      fp = MixFingerprint(fp, r.source + 1);
+      matched_.insert(fp);
+      ForcedMatch match = { rank, index, r.source };
+      prefix.push_back(match);
+      index++;
+    }
   }
 }
 
@@ -505,7 +1093,7 @@ bool success = false;
 
 int cnt = 0;
 
-for (size_t i = 0; i < prev_ex.path().constraints().size(); i++) {
+for (size_t i = 0; i < prev_ex.path().num_constraints(); i++) {
 
   size_t bid_idx = prev_ex.path().constraints_idx()[i];
   branch_id_t bid = prev_ex.path().branches()[bid_idx];
@@ -516,7 +1104,7 @@ for (size_t i = 0; i < prev_ex.path().constraints().size(); i++) {
     if (++cnt == 1000) {
   cnt = 0;
   fprintf(stderr, "Failed to solve at %u/%u.\n",
-      i, prev_ex.path().constraints().size());
+      i, prev_ex.path().num_constraints());
     }
     continue;
   }
@@ -540,14 +1128,14 @@ return success;
 void RandomSearch::SolveUncoveredBranches(size_t i, int depth, const SymbolicExecution& prev_ex) {
   if (depth < 0) return;
 
-  fprintf(stderr, "position: %zu/%zu (%d)\n", i, prev_ex.path().constraints().size(), depth);
+  fprintf(stderr, "position: %zu/%zu (%d)\n", i, prev_ex.path().num_constraints(), depth);
 
   SymbolicExecution cur_ex;
   vector<value_t> input;
 
   int cnt = 0;
 
-  for (size_t j = i; j < prev_ex.path().constraints().size(); j++) {
+  for (size_t j = i; j < prev_ex.path().num_constraints(); j++) {
     size_t bid_idx = prev_ex.path().constraints_idx()[j];
     branch_id_t bid = prev_ex.path().branches()[bid_idx];
     if (covered_[paired_branch_[bid]]) continue;
@@ -555,7 +1143,7 @@ void RandomSearch::SolveUncoveredBranches(size_t i, int depth, const SymbolicExe
     if (!SolveAtBranch(prev_ex, j, &input)) {
       if (++cnt == 1000) {
         cnt = 0;
-        fprintf(stderr, "Failed to solve at %zu/%zu.\n", j, prev_ex.path().constraints().size());
+        fprintf(stderr, "Failed to solve at %zu/%zu.\n", j, prev_ex.path().num_constraints());
       }
       continue;
     }
@@ -576,10 +1164,10 @@ bool RandomSearch::SolveRandomBranch(vector<value_t>* next_input, size_t* idx) {
   /*
   const SymbolicPath& p = ex_.path();
   vector<ScoredBranch> zero_branches, other_branches;
-  zero_branches.reserve(p.constraints().size());
-  other_branches.reserve(p.constraints().size());
+  zero_branches.reserve(p.num_constraints());
+  other_branches.reserve(p.num_constraints());
 
-  vector<size_t> idxs(p.constraints().size());
+  vector<size_t> idxs(p.num_constraints());
   for (size_t i = 0; i < idxs.size(); i++) {
     idxs[i] = i;
   }
@@ -611,7 +1199,7 @@ bool RandomSearch::SolveRandomBranch(vector<value_t>* next_input, size_t* idx) {
   }
   */
 
-  vector<size_t> idxs(ex_.path().constraints().size());
+  vector<size_t> idxs(ex_.path().num_constraints());
   for (size_t i = 0; i < idxs.size(); i++) idxs[i] = i;
 
   for (int tries = 0; tries < 1000; tries++) {
@@ -662,10 +1250,10 @@ void UniformRandomSearch::DoUniformRandomPath() {
 
   size_t i = 0;
   size_t depth = 0;
-  fprintf(stderr, "%zu constraints.\n", prev_ex_.path().constraints().size());
-  while ((i < prev_ex_.path().constraints().size()) && (depth < max_depth_)) {
+  fprintf(stderr, "%zu constraints.\n", prev_ex_.path().num_constraints());
+  while ((i < prev_ex_.path().num_constraints()) && (depth < max_depth_)) {
     if (SolveAtBranch(prev_ex_, i, &input)) {
-      fprintf(stderr, "Solved constraint %zu/%zu.\n", (i + 1), prev_ex_.path().constraints().size());
+      fprintf(stderr, "Solved constraint %zu/%zu.\n", (i + 1), prev_ex_.path().num_constraints());
       depth++;
 
       // With probability 0.5, force the i-th constraint.
@@ -704,7 +1292,7 @@ void HybridSearch::Run() {
     UpdateCoverage(ex);
 
     // Local searches at increasingly deeper execution points.
-    for (size_t pos = 0; pos < ex.path().constraints().size(); pos += step_size_) {
+    for (size_t pos = 0; pos < ex.path().num_constraints(); pos += step_size_) {
       RandomLocalSearch(&ex, pos, pos + step_size_);
     }
   }
@@ -718,8 +1306,8 @@ void HybridSearch::RandomLocalSearch(SymbolicExecution* ex, size_t start, size_t
 
 bool HybridSearch::RandomStep(SymbolicExecution* ex, size_t start, size_t end) {
 
-  if (end > ex->path().constraints().size()) {
-    end = ex->path().constraints().size();
+  if (end > ex->path().num_constraints()) {
+    end = ex->path().num_constraints();
   }
   assert(start < end);
 
@@ -783,37 +1371,30 @@ bool CfgBaselineSearch::DoSearch(int depth, int iters, int pos, const SymbolicEx
   // For each symbolic branch/constraint in the execution path, we will
   // compute a heuristic score, and then attempt to force the branches
   // in order of increasing score.
-  vector<ScoredBranch> scoredBranches(prev_ex.path().constraints().size() - pos);
-  for (size_t i = 0; i < scoredBranches.size(); i++) {
-    scoredBranches[i].first = i + pos;
-  }
-
-  {  // Compute (and sort by) the scores.
-    random_shuffle(scoredBranches.begin(), scoredBranches.end());
-    map<branch_id_t, int> seen;
-    for (size_t i = 0; i < scoredBranches.size(); i++) {
-      size_t idx = scoredBranches[i].first;
-      size_t branch_idx = prev_ex.path().constraints_idx()[idx];
+  CandidateQueue candidates;
+  {  // Compute the scores, in a random order.
+    vector<size_t> order;
+    ShuffledConstraints(prev_ex, pos, &order);
+    ResetSeenCounts();
+    for (size_t i = 0; i < order.size(); i++) {
+      size_t branch_idx = prev_ex.path().constraints_idx()[order[i]];
       branch_id_t bid = paired_branch_[prev_ex.path().branches()[branch_idx]];
-      if (covered_[bid]) {
-        scoredBranches[i].second = 100000000 + seen[bid];
-      } else {
-        scoredBranches[i].second = seen[bid];
-      }
-      seen[bid] += 1;
+      int seen = CountSeen(bid);
+      candidates.Add(order[i], covered_[bid] ? 100000000 + seen : seen);
     }
+    candidates.Build();
   }
-  stable_sort(scoredBranches.begin(), scoredBranches.end(), ScoredBranchComp());
 
   // Solve.
   SymbolicExecution cur_ex;
   vector<value_t> input;
-  for (size_t i = 0; i < scoredBranches.size(); i++) {
+  ScoredBranch next;
+  while (candidates.Pop(&next)) {
     if (iters <= 0) {
       return false;
     }
 
-    if (!SolveAtBranch(prev_ex, scoredBranches[i].first, &input)) {
+    if (!SolveAtBranch(prev_ex, next.first, &input)) {
       continue;
     }
 
@@ -834,30 +1415,12 @@ bool CfgBaselineSearch::DoSearch(int depth, int iters, int pos, const SymbolicEx
 ////////////////////////////////////////////////////////////////////////
 
 CfgHeuristicSearch::CfgHeuristicSearch(const string& program, int max_iterations, int num_mpi_procs)
-    : Search(program, max_iterations, num_mpi_procs), cfg_(max_branch_), cfg_rev_(max_branch_), dist_(max_branch_) {
-
-  // Read in the CFG.
-  ifstream in("cfg_branches", ios::in | ios::binary);
-  assert(in);
-  size_t num_branches;
-  in.read((char*)&num_branches, sizeof(num_branches));
-  assert(num_branches == branches_.size());
-  for (size_t i = 0; i < num_branches; i++) {
-    branch_id_t src;
-    size_t len;
-    in.read((char*)&src, sizeof(src));
-    in.read((char*)&len, sizeof(len));
-    cfg_[src].resize(len);
-    in.read((char*)&cfg_[src].front(), len * sizeof(branch_id_t));
-  }
-  in.close();
-
-  // Construct the reversed CFG.
-  for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
-    for (BranchIt j = cfg_[*i].begin(); j != cfg_[*i].end(); ++j) {
-      cfg_rev_[*j].push_back(*i);
-    }
-  }
+    : Search(program, max_iterations, num_mpi_procs),
+      dist_(&metadata_, kInfiniteDistance),
+      num_distance_updates_(0),
+      distance_update_time_(0.0),
+      max_distance_update_time_(0.0) {
+  log_new_coverage_ = true;
 }
 
 CfgHeuristicSearch::~CfgHeuristicSearch() {}
@@ -869,12 +1432,15 @@ void CfgHeuristicSearch::Run() {
   while (true) {
     covered_.assign(max_branch_, false);
     num_covered_ = 0;
+    new_coverage_.clear();
+    dist_.Reset();
 
     // Execution on empty/random inputs.
     fprintf(stderr, "RESET\n");
     RunProgram(vector<value_t>(), &ex);
     if (UpdateCoverage(ex)) {
-      UpdateBranchDistances();
+      UpdateBranchDistances(new_coverage_);
+      new_coverage_.clear();
       PrintStats();
     }
 
@@ -883,7 +1449,8 @@ void CfgHeuristicSearch::Run() {
       // while (DoSearch(3, 10000, 0, kInfiniteDistance, ex)) {
       PrintStats();
       // As long as we keep finding new branches . . . .
-      UpdateBranchDistances();
+      UpdateBranchDistances(new_coverage_);
+      new_coverage_.clear();
       ex.Swap(success_ex_);
     }
     PrintStats();
@@ -904,82 +1471,71 @@ void CfgHeuristicSearch::PrintStats() {
           num_solve_all_concrete_, num_solve_no_paths_);
   fprintf(stderr, "    (sat failures: %u/%u)  (prediction failures: %u) (recursions: %u)\n", num_solve_unsats_,
           num_solve_sat_attempts_, num_solve_pred_fails_, num_solve_recurses_);
+  fprintf(stderr, "Distance updates: %u (%zu branches repaired, %.3f ms avg, %.3f ms max)\n", num_distance_updates_,
+          dist_.num_repaired(),
+          num_distance_updates_ ? 1000.0 * distance_update_time_ / num_distance_updates_ : 0.0,
+          1000.0 * max_distance_update_time_);
 }
 
-void CfgHeuristicSearch::UpdateBranchDistances() {
-  // We run a BFS backward, starting simultaneously at all uncovered vertices.
-  queue<branch_id_t> Q;
-  for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
-    if (!covered_[*i]) {
-      dist_[*i] = 0;
-      Q.push(*i);
-    } else {
-      dist_[*i] = kInfiniteDistance;
-    }
+void CfgHeuristicSearch::UpdateBranchDistances(const vector<branch_id_t>& newly_covered) {
+  // Rather than a BFS backward from all uncovered branches, repair the
+  // distances around just the newly covered branches.
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  for (BranchIt i = newly_covered.begin(); i != newly_covered.end(); ++i) {
+    dist_.Cover(*i);
   }
+  gettimeofday(&end, NULL);
 
-  while (!Q.empty()) {
-    branch_id_t i = Q.front();
-    size_t dist_i = dist_[i];
-    Q.pop();
-
-    for (BranchIt j = cfg_rev_[i].begin(); j != cfg_rev_[i].end(); ++j) {
-      if (dist_i + 1 < dist_[*j]) {
-        dist_[*j] = dist_i + 1;
-        Q.push(*j);
-      }
-    }
-  }
+  double elapsed = (end.tv_sec - start.tv_sec) + 1e-6 * (end.tv_usec - start.tv_usec);
+  num_distance_updates_++;
+  distance_update_time_ += elapsed;
+  if (elapsed > max_distance_update_time_) max_distance_update_time_ = elapsed;
 }
 
 bool CfgHeuristicSearch::DoSearch(int depth, int iters, int pos, int maxDist, const SymbolicExecution& prev_ex) {
 
   fprintf(stderr, "DoSearch(%d, %d, %d, %zu)\n", depth, pos, maxDist, prev_ex.path().branches().size());
 
-  if (pos >= static_cast<int>(prev_ex.path().constraints().size())) return false;
+  if (pos >= static_cast<int>(prev_ex.path().num_constraints())) return false;
 
   if (depth == 0) return false;
 
   // For each symbolic branch/constraint in the execution path, we will
   // compute a heuristic score, and then attempt to force the branches
   // in order of increasing score.
-  vector<ScoredBranch> scoredBranches(prev_ex.path().constraints().size() - pos);
-  for (size_t i = 0; i < scoredBranches.size(); i++) {
-    scoredBranches[i].first = i + pos;
-  }
-
-  {  // Compute (and sort by) the scores.
-    random_shuffle(scoredBranches.begin(), scoredBranches.end());
-    map<branch_id_t, int> seen;
-    for (size_t i = 0; i < scoredBranches.size(); i++) {
-      size_t idx = scoredBranches[i].first;
-      size_t branch_idx = prev_ex.path().constraints_idx()[idx];
+  CandidateQueue candidates;
+  {  // Compute the scores, in a random order.
+    vector<size_t> order;
+    ShuffledConstraints(prev_ex, pos, &order);
+    ResetSeenCounts();
+    for (size_t i = 0; i < order.size(); i++) {
+      size_t branch_idx = prev_ex.path().constraints_idx()[order[i]];
       branch_id_t bid = paired_branch_[prev_ex.path().branches()[branch_idx]];
 
-      scoredBranches[i].second = dist_[bid] + seen[bid];
-      seen[bid] += 1;
+      candidates.Add(order[i], dist_[bid] + CountSeen(bid));
 
       /*
       if (dist_[bid] == 0) {
-        scoredBranches[i].second = 0;
+        candidates.Add(order[i], 0);
       } else {
-        scoredBranches[i].second = dist_[bid] + seen[bid];
-        seen[bid] += 1;
+        candidates.Add(order[i], dist_[bid] + CountSeen(bid));
       }
       */
     }
+    candidates.Build();
   }
-  stable_sort(scoredBranches.begin(), scoredBranches.end(), ScoredBranchComp());
 
   // Solve.
   SymbolicExecution cur_ex;
   vector<value_t> input;
-  for (size_t i = 0; i < scoredBranches.size(); i++) {
-    if ((iters <= 0) || (scoredBranches[i].second > maxDist)) return false;
+  ScoredBranch next;
+  while (candidates.Pop(&next)) {
+    if ((iters <= 0) || (next.second > maxDist)) return false;
 
     num_inner_solves_++;
 
-    if (!SolveAtBranch(prev_ex, scoredBranches[i].first, &input)) {
+    if (!SolveAtBranch(prev_ex, next.first, &input)) {
       num_inner_unsats_++;
       continue;
     }
@@ -987,7 +1543,7 @@ bool CfgHeuristicSearch::DoSearch(int depth, int iters, int pos, int maxDist, co
     RunProgram(input, &cur_ex);
     iters--;
 
-    size_t b_idx = prev_ex.path().constraints_idx()[scoredBranches[i].first];
+    size_t b_idx = prev_ex.path().constraints_idx()[next.first];
     branch_id_t bid = paired_branch_[prev_ex.path().branches()[b_idx]];
     set<branch_id_t> new_branches;
     bool found_new_branch = UpdateCoverage(cur_ex, &new_branches);
@@ -998,7 +1554,7 @@ bool CfgHeuristicSearch::DoSearch(int depth, int iters, int pos, int maxDist, co
       fprintf(stderr,
               "Found new branch by forcing at "
               "distance %zu (%d) [lucky, pred failed].\n",
-              dist_[bid], scoredBranches[i].second);
+              dist_[bid], next.second);
 
       // We got lucky, and can't really compute any further stats
       // because prediction failed.
@@ -1009,7 +1565,7 @@ bool CfgHeuristicSearch::DoSearch(int depth, int iters, int pos, int maxDist, co
     }
 
     if (found_new_branch && !prediction_failed) {
-      fprintf(stderr, "Found new branch by forcing at distance %zu (%d).\n", dist_[bid], scoredBranches[i].second);
+      fprintf(stderr, "Found new branch by forcing at distance %zu (%d).\n", dist_[bid], next.second);
       size_t min_dist = MinCflDistance(b_idx, cur_ex, new_branches);
       // Check if we were lucky.
       if (FindAlongCfg(b_idx, dist_[bid], cur_ex, new_branches)) {
@@ -1039,9 +1595,9 @@ bool CfgHeuristicSearch::DoSearch(int depth, int iters, int pos, int maxDist, co
       }
     }
 
-    // If we reached here, then scoredBranches[i].second is greater than 0.
+    // If we reached here, then next.second is greater than 0.
     num_top_solves_++;
-    if ((dist_[bid] > 0) && SolveAlongCfg(b_idx, scoredBranches[i].second - 1, cur_ex)) {
+    if ((dist_[bid] > 0) && SolveAlongCfg(b_idx, next.second - 1, cur_ex)) {
       num_top_solve_successes_++;
       PrintStats();
       return true;
@@ -1053,7 +1609,7 @@ bool CfgHeuristicSearch::DoSearch(int depth, int iters, int pos, int maxDist, co
     }
 
     /*
-    if (DoSearch(depth-1, 5, scoredBranches[i].first+1, scoredBranches[i].second-1, cur_ex)) {
+    if (DoSearch(depth-1, 5, next.first+1, next.second-1, cur_ex)) {
       num_inner_recursive_successes_ ++;
       return true;
     }
@@ -1280,8 +1836,7 @@ bool CfgHeuristicSearch::DoBoundedBFS(int i, int depth, const SymbolicExecution&
 
   SymbolicExecution cur_ex;
   vector<value_t> input;
-  const vector<SymbolicPred*>& constraints = prev_ex.path().constraints();
-  for (size_t j = static_cast<size_t>(i); j < constraints.size(); j++) {
+  for (size_t j = static_cast<size_t>(i); j < prev_ex.path().num_constraints(); j++) {
     if (!SolveAtBranch(prev_ex, j, &input)) {
       continue;
     }
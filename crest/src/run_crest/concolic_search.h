@@ -12,6 +12,8 @@
 #define RUN_CREST_CONCOLIC_SEARCH_H__
 
 #include <time.h>
+#include <sys/types.h>
+#include <deque>
 #include <ext/hash_map>
 #include <ext/hash_set>
 #include <map>
@@ -24,10 +26,16 @@
 */
 
 #include "base/basic_types.h"
+#include "base/branch_distances.h"
+#include "base/coverage_map.h"
+#include "base/program_metadata.h"
 #include "base/symbolic_execution.h"
+#include "base/transport.h"
+#include "base/yices_solver.h"
 
 using __gnu_cxx::hash_map;
 using __gnu_cxx::hash_set;
+using std::deque;
 using std::map;
 using std::vector;
 
@@ -40,7 +48,19 @@ class Search {
 
   virtual void Run() = 0;
 
+  // Run the program under test as a fork server (see base/fork_server.h),
+  // instead of launching a new MPI job for every execution.
+  void set_fork_server(bool fork_server) { fork_server_ = fork_server; }
+
+  // How inputs and executions are passed to and from the program under
+  // test (see base/transport.h).
+  void set_transport(transport::kind_t kind) { transport_kind_ = kind; }
+
  protected:
+  // The branches and thinned CFG of the program (see
+  // base/program_metadata.h).
+  ProgramMetadata metadata_;
+
   vector<branch_id_t> branches_;
   vector<branch_id_t> paired_branch_;
   vector<function_id_t> branch_function_;
@@ -50,6 +70,11 @@ class Search {
   unsigned int num_covered_;
   unsigned int total_num_covered_;
 
+  // If log_new_coverage_ is set, CoverBranch appends each branch it
+  // newly marks in covered_ to new_coverage_ (for the search to drain).
+  bool log_new_coverage_;
+  vector<branch_id_t> new_coverage_;
+
   vector<bool> reached_;
   vector<unsigned int> branch_count_;
   function_id_t max_function_;
@@ -58,32 +83,87 @@ class Search {
 
   time_t start_time_;
 
+  // The counts for CountSeen, valid where stamped with seen_epoch_ (so
+  // resetting them takes constant time).
+  vector<unsigned> seen_count_;
+  vector<unsigned> seen_stamp_;
+  unsigned seen_epoch_;
+
   typedef vector<branch_id_t>::const_iterator BranchIt;
 
   bool SolveAtBranch(const SymbolicExecution& ex, size_t branch_idx, vector<value_t>* input);
 
+  // As above, but checks against 'session', which must already hold
+  // constraints [0..branch_idx-1] of 'ex', instead of a new context.
+  bool SolveAtBranch(const SymbolicExecution& ex, size_t branch_idx, YicesSession* session, vector<value_t>* input);
+
   bool CheckPrediction(const SymbolicExecution& old_ex, const SymbolicExecution& new_ex, size_t branch_idx);
 
   void RunProgram(const vector<value_t>& inputs, SymbolicExecution* ex);
   bool UpdateCoverage(const SymbolicExecution& ex);
   bool UpdateCoverage(const SymbolicExecution& ex, set<branch_id_t>* new_branches);
+  void CoverBranch(branch_id_t bid, set<branch_id_t>* new_branches);
 
   void RandomInput(const map<var_t, type_t>& vars, vector<value_t>* input);
 
+  // Fills 'order' with the indices of constraints [pos..] of 'ex', in a
+  // random order.
+  void ShuffledConstraints(const SymbolicExecution& ex, size_t pos, vector<size_t>* order);
+
+  // Counts branches while scoring a path.  CountSeen returns how many
+  // times 'bid' was counted since the last ResetSeenCounts, and counts
+  // it once more.
+  void ResetSeenCounts();
+  unsigned CountSeen(branch_id_t bid);
+
+  // Counts one more execution, unless the iteration limit is reached.
+  bool TakeIteration();
+
+  int num_mpi_procs() const { return num_mpi_procs_; }
+  transport::kind_t transport_kind() const { return transport_kind_; }
+
+  // Starts (without waiting for) the program on 'inputs', with working
+  // directory 'dir' (a subdirectory of the current one), talking over
+  // 'server' (a transport in 'dir') and recording its coverage in
+  // 'coverage' (if not NULL).  Returns the pid of the MPI launcher.
+  pid_t StartProgram(const string& dir, TransportServer* server, CoverageMap* coverage,
+                     const vector<value_t>& inputs);
+
+  // Parses the execution that finished in 'server' into 'ex', along with
+  // its coverage from 'coverage' (if not NULL).
+  void FinishProgram(TransportServer* server, const CoverageMap* coverage, SymbolicExecution* ex);
+
  private:
   const string program_;
   const int max_iters_;
   int num_iters_;
   int num_mpi_procs_;
 
-  /*
-  struct sockaddr_un sock_;
-  int sockd_;
-  */
+  // Fork server state.
+  bool fork_server_;
+  pid_t server_pid_;
+  vector<int> server_cmd_fds_;
+  vector<int> server_reply_fds_;
+
+  transport::kind_t transport_kind_;
+  TransportServer* transport_;
+
+  // Where the program under test marks the branches it covers (NULL if
+  // shared memory is unavailable).  Created with the transport.
+  CoverageMap* coverage_;
+
+  // The append-only log of covered branches, one per line.
+  FILE* coverage_log_;
+
+  // The ranks of the last run.  (RunProgram swaps the merged execution
+  // out to its caller, but the per-rank offsets stay valid for it.)
+  MultiRankExecution last_run_;
 
   void WriteInputToFileOrDie(const string& file, const vector<value_t>& input);
-  void WriteCoverageToFileOrDie(const string& file);
+  void LogCoverageOrDie(branch_id_t bid);
   void LaunchProgram(const vector<value_t>& inputs);
+  void StartForkServer();
+  void StopForkServer();
 };
 
 class BoundedDepthFirstSearch : public Search {
@@ -96,7 +176,7 @@ class BoundedDepthFirstSearch : public Search {
  private:
   int max_depth_;
 
-  void DFS(size_t pos, int depth, SymbolicExecution& prev_ex);
+  void DFS(size_t pos, int depth, SymbolicExecution& prev_ex, YicesSession* session);
 };
 
 /*
@@ -114,6 +194,92 @@ class OldDepthFirstSearch : public Search {
 };
 */
 
+// A generational search (as in SAGE).  Every execution negates each of
+// its constraints from its bound on, and the child input for constraint
+// i gets bound i+1.  An execution is scored by the number of new
+// branches it covered, and the highest-scored executions are expanded
+// first.
+//
+// Up to 'num_jobs' executions of the program run at once, each in its
+// own working directory, "crest_job.<k>", so their inputs, executions,
+// and logs do not collide.  Each slot keeps its own frontier of the
+// executions it ran, and a slot whose frontier is empty steals the best
+// execution from another.  Solving happens in this process while the
+// executions run: each busy slot gets its next input solved ahead.
+class GenerationalSearch : public Search {
+ public:
+  GenerationalSearch(const string& program, int max_iterations, int num_mpi_procs, int num_jobs);
+  virtual ~GenerationalSearch();
+
+  virtual void Run();
+
+  // Also explore the matches of wildcard receives: each execution is
+  // expanded both by negating its constraints and by forcing one of its
+  // wildcard receives to match another send that raced for it (see
+  // base/receive_schedule.h).
+  void set_explore_receives(bool explore) { explore_receives_ = explore; }
+
+ private:
+  struct Node {
+    SymbolicExecution ex;
+    size_t next;        // The next constraint to negate.
+    size_t score;       // The number of new branches covered.
+    bool in_frontier;
+    int num_children;   // Children solved but not yet run.
+    vector<ForcedMatch> schedule;                // The matches it ran with.
+    vector<vector<ForcedMatch> > alternatives;   // Schedules left to run.
+  };
+
+  struct NodeLess {
+    bool operator()(const Node* a, const Node* b) const { return a->score < b->score; }
+  };
+
+  struct Child {
+    vector<value_t> input;
+    Node* parent;       // NULL for the initial execution.
+    size_t idx;         // The constraint of 'parent' negated.
+    bool reorder;       // Or, the same input with another schedule.
+    vector<ForcedMatch> schedule;
+  };
+
+  struct Slot {
+    pid_t pid;          // -1 if idle.
+    string dir;
+    TransportServer* transport;
+    CoverageMap* coverage;   // NULL if unavailable.
+    vector<Node*> frontier;  // A max-heap on score.
+    deque<Child> ready;
+    Child running;
+  };
+
+  const int num_jobs_;
+  vector<Slot> slots_;
+  int num_running_;
+
+  // The fingerprints (see SymbolicPath::NegationFingerprint) of every
+  // query solved so far.  Executions often share long prefixes, so the
+  // same negation comes up again and again.
+  hash_set<fingerprint_t,FingerprintHash> tried_;
+
+  bool explore_receives_;
+  // The fingerprints of the (input, rank, matches of the rank's first k
+  // wildcard receives) run or scheduled so far.
+  hash_set<fingerprint_t,FingerprintHash> matched_;
+
+  // Stats.
+  unsigned num_steals_;
+  unsigned num_pred_fails_;
+  unsigned num_repeats_;
+  unsigned num_reorders_;
+
+  bool SolveFor(size_t k);
+  Node* TopOrSteal(size_t k);
+  void Launch(size_t k);
+  void Reap(bool block);
+  void Release(Node* node);
+  void FindAlternatives(Node* node);
+};
+
 class RandomInputSearch : public Search {
  public:
   RandomInputSearch(const string& program, int max_iterations, int num_mpi_procs);
@@ -209,13 +375,10 @@ class CfgHeuristicSearch : public Search {
   virtual void Run();
 
  private:
-  typedef vector<branch_id_t> nbhr_list_t;
-  vector<nbhr_list_t> cfg_;
-  vector<nbhr_list_t> cfg_rev_;
-  vector<size_t> dist_;
-
   static const size_t kInfiniteDistance = 10000;
 
+  BranchDistances dist_;
+
   int iters_left_;
 
   SymbolicExecution success_ex_;
@@ -242,7 +405,12 @@ class CfgHeuristicSearch : public Search {
   unsigned num_solve_all_concrete_;
   unsigned num_solve_no_paths_;
 
-  void UpdateBranchDistances();
+  unsigned num_distance_updates_;
+  double distance_update_time_;      // In seconds.
+  double max_distance_update_time_;
+
+  // Updates the distances for the branches in 'newly_covered'.
+  void UpdateBranchDistances(const vector<branch_id_t>& newly_covered);
   void PrintStats();
   bool DoSearch(int depth, int iters, int pos, int maxDist, const SymbolicExecution& prev_ex);
   bool DoBoundedBFS(int i, int depth, const SymbolicExecution& prev_ex);
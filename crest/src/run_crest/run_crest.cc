@@ -10,20 +10,94 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #include "run_crest/concolic_search.h"
 
+namespace {
+
+// run_crest's pid and solver dump file, for PrintSummaries.
+pid_t main_pid;
+FILE* dump = NULL;
+
+// Prints the solver and cache summaries when run_crest exits -- most
+// searches stop by calling exit() from inside Run(), once they reach
+// the iteration limit.
+void PrintSummaries() {
+  // Not in a forked child that exits.
+  if (getpid() != main_pid)
+    return;
+  crest::YicesSolver::stats()->PrintSummary(stderr);
+  if (crest::YicesSolver::cache()->enabled())
+    crest::YicesSolver::cache()->PrintSummary(stderr);
+  if (dump) {
+    crest::YicesSolver::stats()->set_dump_file(NULL);
+    fclose(dump);
+    dump = NULL;
+  }
+}
+
+}  // namespace
+
 int main(int argc, char* argv[]) {
+  // Pull out the "--option" flags, which may appear anywhere.
+  bool fork_server = false;
+  crest::transport::kind_t transport_kind = crest::transport::FILES;
+  const char* solver_dump = NULL;
+  bool solver_cache = true;
+  bool explore_receives = false;
+  {
+    int n = 0;
+    for (int i = 0; i < argc; i++) {
+      if (!strcmp(argv[i], "--fork_server")) {
+        fork_server = true;
+      } else if (!strncmp(argv[i], "--transport=", 12)) {
+        if (!crest::transport::ParseKind(argv[i] + 12, &transport_kind)) {
+          fprintf(stderr, "Unknown transport: %s\n", argv[i] + 12);
+          return 1;
+        }
+      } else if (!strncmp(argv[i], "--solver_dump=", 14)) {
+        solver_dump = argv[i] + 14;
+      } else if (!strcmp(argv[i], "--no_solver_cache")) {
+        solver_cache = false;
+      } else if (!strcmp(argv[i], "--explore_receives")) {
+        explore_receives = true;
+      } else {
+        argv[n++] = argv[i];
+      }
+    }
+    argc = n;
+  }
+
   if (argc < 5) {
     fprintf(stderr,
             "Syntax: run_crest <program> "
             "<number of iterations> "
             "<number of mpi programs>"
-            "-<strategy> [strategy options]\n");
+            "-<strategy> [strategy options] [--fork_server] "
+            "[--transport=file|socket|shm] [--solver_dump=<file>] "
+            "[--no_solver_cache] [--explore_receives]\n");
     fprintf(stderr,
             "  Strategies include: "
-            "dfs, cfg, random, uniform_random, random_input \n");
+            "dfs, cfg, random, uniform_random, random_input, "
+            "generational [jobs]\n");
+    fprintf(stderr,
+            "  --fork_server starts the MPI job once and forks each "
+            "execution from it (requires CR_MPI_Init/CR_MPI_Finalize)\n");
+    fprintf(stderr,
+            "  --transport picks how inputs and executions are passed "
+            "(default: file)\n");
+    fprintf(stderr,
+            "  --solver_dump writes every solver query and its result "
+            "to <file>\n");
+    fprintf(stderr,
+            "  --no_solver_cache disables the cache of solver results\n");
+    fprintf(stderr,
+            "  --explore_receives also explores the sends each MPI_ANY_SOURCE "
+            "receive could match (generational only)\n");
     return 1;
   }
 
@@ -37,6 +111,17 @@ int main(int argc, char* argv[]) {
   gettimeofday(&tv, NULL);
   srand((tv.tv_sec * 1000000) + tv.tv_usec);
 
+  crest::YicesSolver::cache()->set_enabled(solver_cache);
+
+  if (solver_dump) {
+    dump = fopen(solver_dump, "w");
+    if (!dump) {
+      fprintf(stderr, "Failed to open %s.\n", solver_dump);
+      return 1;
+    }
+    crest::YicesSolver::stats()->set_dump_file(dump);
+  }
+
   crest::Search* strategy;
   if (search_type == "-random") {
     strategy = new crest::RandomSearch(prog, num_iters, num_mpi_procs);
@@ -60,11 +145,45 @@ int main(int argc, char* argv[]) {
     } else {
       strategy = new crest::UniformRandomSearch(prog, num_iters, num_mpi_procs, atoi(argv[5]));
     }
+  } else if ((search_type == "-generational") || (search_type == "-parallel")) {
+    // (A socket server must be serviced while the program runs, and these
+    // searches just wait for their jobs to exit.)
+    if (fork_server || (transport_kind == crest::transport::UNIX_SOCKET)) {
+      fprintf(stderr, "%s supports only the file and shm transports.\n", search_type.c_str());
+      return 1;
+    }
+    int num_jobs;
+    if (argc > 5) {
+      num_jobs = atoi(argv[5]);
+    } else if (search_type == "-parallel") {
+      // By default, about one MPI process per core.
+      num_jobs = sysconf(_SC_NPROCESSORS_ONLN) / num_mpi_procs;
+    } else {
+      num_jobs = 1;
+    }
+    if (num_jobs < 1) num_jobs = 1;
+    crest::GenerationalSearch* generational = new crest::GenerationalSearch(prog, num_iters, num_mpi_procs, num_jobs);
+    generational->set_explore_receives(explore_receives);
+    strategy = generational;
   } else {
     fprintf(stderr, "Unknown search strategy: %s\n", search_type.c_str());
     return 1;
   }
 
+  if (explore_receives && (search_type != "-generational") && (search_type != "-parallel")) {
+    fprintf(stderr, "--explore_receives requires -generational or -parallel.\n");
+    return 1;
+  }
+
+  strategy->set_fork_server(fork_server);
+  strategy->set_transport(transport_kind);
+
+  // Print the summaries however the search ends.  (The stats are
+  // constructed first, so that they outlive the handler.)
+  crest::YicesSolver::stats();
+  main_pid = getpid();
+  atexit(PrintSummaries);
+
   strategy->Run();
 
   delete strategy;
@@ -0,0 +1,162 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <vector>
+
+#include "base/addr_map.h"
+#include "base/trace_writer.h"
+
+using namespace crest;
+using std::map;
+using std::vector;
+
+// Compares the interpreter's symbolic memory map (AddrMap) against the
+// std::map it replaced, on a sequence of loads and stores.
+//
+//   bench_addr_map [trace.<rank>.bin]
+//
+// With a trace (from a program built with CREST_TRACE), replays its
+// LOAD and STORE events.  Otherwise, uses a synthetic trace: sweeps over
+// a large symbolic array, mixed with accesses to scattered scalars.
+
+namespace {
+
+enum { LOAD, STORE, ERASE };
+
+struct Op {
+  int kind;
+  addr_t addr;
+};
+
+bool ReadTrace(const char* file, vector<Op>* ops) {
+  FILE* f = fopen(file, "rb");
+  if (!f) {
+    fprintf(stderr, "Failed to open %s.\n", file);
+    return false;
+  }
+  TraceHeader h;
+  if ((fread(&h, sizeof(h), 1, f) != 1)
+      || memcmp(h.magic, kTraceMagic, sizeof(h.magic))
+      || (h.record_size != sizeof(TraceRecord))) {
+    fprintf(stderr, "%s: not a CREST trace.\n", file);
+    fclose(f);
+    return false;
+  }
+  TraceRecord r;
+  while (fread(&r, sizeof(r), 1, f) == 1) {
+    if ((r.event == trace::LOAD) && (r.arg != 0)) {
+      Op op = { LOAD, r.arg };
+      ops->push_back(op);
+    } else if ((r.event == trace::STORE) && (r.arg != 0)) {
+      Op op = { STORE, r.arg };
+      ops->push_back(op);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+void SyntheticTrace(vector<Op>* ops) {
+  const addr_t kArray = 0x10000000;
+  const size_t kArrayLen = 1 << 16;
+  const size_t kScalars = 256;
+  srand(1);
+  for (int pass = 0; pass < 40; pass++) {
+    for (size_t i = 0; i < kArrayLen; i++) {
+      Op load = { LOAD, kArray + 4 * i };
+      Op store = { (i % 8 == 7) ? ERASE : STORE, kArray + 4 * ((i * 7) % kArrayLen) };
+      Op scalar = { LOAD, 0x7ff000000000UL + 8 * (rand() % kScalars) };
+      ops->push_back(load);
+      ops->push_back(store);
+      ops->push_back(scalar);
+    }
+  }
+}
+
+double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// A dummy expression for stored values.
+char kExpr;
+
+size_t RunStdMap(const vector<Op>& ops) {
+  map<addr_t,char*> mem;
+  size_t hits = 0;
+  for (size_t i = 0; i < ops.size(); i++) {
+    switch (ops[i].kind) {
+    case LOAD:
+      if (mem.find(ops[i].addr) != mem.end()) hits++;
+      break;
+    case STORE:
+      mem[ops[i].addr] = &kExpr;
+      break;
+    case ERASE:
+      mem.erase(ops[i].addr);
+      break;
+    }
+  }
+  return hits;
+}
+
+size_t RunAddrMap(const vector<Op>& ops) {
+  AddrMap<char*> mem;
+  size_t hits = 0;
+  for (size_t i = 0; i < ops.size(); i++) {
+    switch (ops[i].kind) {
+    case LOAD:
+      if (mem.Find(ops[i].addr) != NULL) hits++;
+      break;
+    case STORE:
+      mem.Set(ops[i].addr, &kExpr);
+      break;
+    case ERASE:
+      mem.Erase(ops[i].addr);
+      break;
+    }
+  }
+  return hits;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  vector<Op> ops;
+  if (argc > 1) {
+    if (!ReadTrace(argv[1], &ops))
+      return 1;
+  } else {
+    SyntheticTrace(&ops);
+  }
+
+  double t0 = Now();
+  size_t std_hits = RunStdMap(ops);
+  double t1 = Now();
+  size_t addr_hits = RunAddrMap(ops);
+  double t2 = Now();
+
+  if (std_hits != addr_hits) {
+    fprintf(stderr, "Mismatch: std::map %zu hits, AddrMap %zu hits.\n",
+            std_hits, addr_hits);
+    return 1;
+  }
+
+  printf("%zu operations (%zu load hits)\n", ops.size(), std_hits);
+  printf("  std::map: %.3fs (%.1f ns/op)\n", t1 - t0, 1e9 * (t1 - t0) / ops.size());
+  printf("  AddrMap:  %.3fs (%.1f ns/op)\n", t2 - t1, 1e9 * (t2 - t1) / ops.size());
+  return 0;
+}
@@ -8,20 +8,37 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
 // for details.
 
-#include <assert.h>
-#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
 #include <iostream>
+#include "base/byte_reader.h"
+#include "base/mapped_file.h"
 #include "base/symbolic_execution.h"
+#include "base/transport.h"
 
 using namespace crest;
 using namespace std;
 
-int main(void) {
+// Prints the execution written by each given rank (by default, rank 0)
+// of a program run with the file transport.
+//
+//   print_execution [rank ...]
+static bool PrintExecution(int rank) {
   SymbolicExecution ex;
 
-  ifstream in("szd_execution", ios::in | ios::binary);
-  assert(ex.Parse(in));
-  in.close();
+  string file = transport::ExecutionFileName(rank);
+  MappedFile in;
+  if (!in.Open(file)) {
+    fprintf(stderr, "Failed to read %s.\n", file.c_str());
+    return false;
+  }
+  ByteReader r(in.data(), in.size());
+  if (!ex.Parse(&r)) {
+    fprintf(stderr, "Failed to read %s.\n", file.c_str());
+    return false;
+  }
+  in.Close();
+  cout << "# rank " << rank << endl;
 
   // Print input.
   for (size_t i = 0; i < ex.inputs().size(); i++) {
@@ -31,19 +48,39 @@ int main(void) {
 
   { // Print the constraints.
     string tmp;
-    for (size_t i = 0; i < ex.path().constraints().size(); i++) {
+    for (size_t i = 0; i < ex.path().num_constraints(); i++) {
       tmp.clear();
-      ex.path().constraints()[i]->AppendToString(&tmp);
+      ex.path().constraint(i)->AppendToString(&tmp);
       cout << tmp << endl;
     }
     cout << endl;
   }
 
+  // Print the branches covered before the path began.
+  const vector<bool>& prefix = ex.path().prefix_covered();
+  cout << "# covered before the first input:";
+  for (size_t i = 0; i < prefix.size(); i++) {
+    if (prefix[i]) cout << " " << i;
+  }
+  cout << endl << endl;
+
   // Print the branches.
   for (size_t i = 0; i < ex.path().branches().size(); i++) {
     cout << ex.path().branches()[i] << "\n";
   }
   cout << endl << endl;
 
-  return 0;
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    return PrintExecution(0) ? 0 : 1;
+  }
+
+  bool ok = true;
+  for (int i = 1; i < argc; i++) {
+    ok = PrintExecution(atoi(argv[i])) && ok;
+  }
+  return ok ? 0 : 1;
 }
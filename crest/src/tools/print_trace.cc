@@ -0,0 +1,83 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <stdio.h>
+#include <string.h>
+#include "base/trace_writer.h"
+
+using namespace crest;
+
+// Prints the binary trace(s) written by an instrumented program built
+// with CREST_TRACE, one event per line.
+//
+//   print_trace [trace.<rank>.bin ...]
+//
+// With no arguments, prints the trace of rank 0.
+static bool PrintTrace(const char* file) {
+  FILE* f = fopen(file, "rb");
+  if (!f) {
+    fprintf(stderr, "Failed to open %s.\n", file);
+    return false;
+  }
+
+  TraceHeader h;
+  if ((fread(&h, sizeof(h), 1, f) != 1)
+      || memcmp(h.magic, kTraceMagic, sizeof(h.magic))
+      || (h.version != kTraceVersion)
+      || (h.record_size != sizeof(TraceRecord))) {
+    fprintf(stderr, "%s: not a CREST trace (or unsupported version).\n", file);
+    fclose(f);
+    return false;
+  }
+  printf("# rank %d\n", h.rank);
+
+  TraceRecord r;
+  while (fread(&r, sizeof(r), 1, f) == 1) {
+    switch (r.event) {
+    case trace::LOAD:
+      printf("load %lu %lld\n", r.arg, r.value); break;
+    case trace::STORE:
+      printf("store %lu\n", r.arg); break;
+    case trace::CLEAR_STACK:
+      printf("clear\n"); break;
+    case trace::APPLY1:
+      printf("apply1 %d %lld\n", (int)r.arg, r.value); break;
+    case trace::APPLY2:
+      printf("apply2 %d %lld\n", (int)r.arg, r.value); break;
+    case trace::COMPARE:
+      printf("compare2 %d %lld\n", (int)r.arg, r.value); break;
+    case trace::BRANCH:
+      printf("branch %d %lld\n", (int)r.arg, r.value); break;
+    case trace::CALL:
+      printf("call %u\n", (unsigned)r.arg); break;
+    case trace::RETURN:
+      printf("return\n"); break;
+    default:
+      fprintf(stderr, "%s: bad event %u.\n", file, r.event);
+      fclose(f);
+      return false;
+    }
+  }
+
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    return PrintTrace(TraceWriter::FileName(0).c_str()) ? 0 : 1;
+  }
+
+  bool ok = true;
+  for (int i = 1; i < argc; i++) {
+    ok = PrintTrace(argv[i]) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -2,8 +2,6 @@
 #include <mpi/mpi.h>
 
 #include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
 
 int main(int argc, char* argv[]) {
 
@@ -20,9 +18,9 @@ int main(int argc, char* argv[]) {
   CR_MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
   if (rank == 0) {
-    srand(time(NULL));
-    num = rand() % 10;
-    printf("num generated : %d\n", num);
+    // Send the symbolic input itself, so the receivers' branches on it
+    // (and rank 0's branch on their results) depend on it.
+    printf("num : %d\n", num);
     CR_MPI_Send(&num, 1, MPI_INT, 1, 1, MPI_COMM_WORLD);
     CR_MPI_Send(&num, 1, MPI_INT, 2, 2, MPI_COMM_WORLD);
   }
@@ -65,6 +63,6 @@ int main(int argc, char* argv[]) {
     printf("Result : %d\n", res);
   }
 
-  MPI_Finalize();
+  CR_MPI_Finalize();
   return 0;
 }